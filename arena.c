@@ -0,0 +1,88 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "tables.h"
+#include "arena.h"
+
+#define ARENA_ALIGN 8
+
+struct ArenaBlock {
+    ArenaBlock* next;
+    size_t used;
+    size_t size;
+    char data[];
+};
+
+void arena_init(Arena* arena, size_t block_size) {
+    arena->head = NULL;
+    arena->block_size = block_size;
+}
+
+/* Pushes a fresh block that can hold at least SIZE bytes. */
+static ArenaBlock* new_block(Arena* arena, size_t size) {
+    size_t block_size = arena->block_size > size ? arena->block_size : size;
+    ArenaBlock* block = (ArenaBlock *) malloc(sizeof(ArenaBlock) + block_size);
+    if (!block) {
+        allocation_failed();
+    }
+    block->next = arena->head;
+    block->used = 0;
+    block->size = block_size;
+    arena->head = block;
+    return block;
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~((size_t) ARENA_ALIGN - 1);
+    ArenaBlock* block = arena->head;
+    if (!block || block->size - block->used < size) {
+        block = new_block(arena, size);
+    }
+    void* ptr = block->data + block->used;
+    block->used += size;
+    return ptr;
+}
+
+char* arena_strdup(Arena* arena, const char* str) {
+    size_t len = strlen(str) + 1;
+    char* copy = (char *) arena_alloc(arena, len);
+    memcpy(copy, str, len);
+    return copy;
+}
+
+char* arena_strndup(Arena* arena, const char* str, size_t len) {
+    char* copy = (char *) arena_alloc(arena, len + 1);
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+void arena_adopt(Arena* dst, Arena* src) {
+    ArenaBlock* last = src->head;
+    if (!last) {
+        return;
+    }
+    while (last->next) {
+        last = last->next;
+    }
+    // Keep the block DST is filling at the head
+    if (dst->head) {
+        last->next = dst->head->next;
+        dst->head->next = src->head;
+    } else {
+        dst->head = src->head;
+    }
+    src->head = NULL;
+}
+
+void arena_release(Arena* arena) {
+    ArenaBlock* block = arena->head;
+    while (block) {
+        ArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->head = NULL;
+}
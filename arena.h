@@ -0,0 +1,37 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/* A bump allocator. Memory is handed out from large blocks and can only be
+   released all at once with arena_release().
+ */
+
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct {
+    ArenaBlock* head;       // block currently being filled
+    size_t block_size;      // minimum size of each new block
+} Arena;
+
+/* Initializes an empty arena. No memory is allocated until the first call to
+   arena_alloc(). */
+void arena_init(Arena* arena, size_t block_size);
+
+/* Returns SIZE bytes of memory owned by ARENA, aligned for any type. */
+void* arena_alloc(Arena* arena, size_t size);
+
+/* Returns a copy of STR allocated in ARENA. */
+char* arena_strdup(Arena* arena, const char* str);
+
+/* Returns a NUL-terminated copy of the LEN characters at STR. */
+char* arena_strndup(Arena* arena, const char* str, size_t len);
+
+/* Moves every block owned by SRC into DST, leaving SRC empty. Memory handed
+   out by SRC stays valid and is freed with DST. */
+void arena_adopt(Arena* dst, Arena* src);
+
+/* Frees every block owned by ARENA. The arena may be reused afterwards. */
+void arena_release(Arena* arena);
+
+#endif
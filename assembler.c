@@ -6,19 +6,36 @@
 #include "src/tables.h"
 #include "src/translate_utils.h"
 #include "src/translate.h"
+#include "src/object.h"
+#include "src/lexer.h"
+#include "src/parallel.h"
+#include "src/stats.h"
+#include "src/cache.h"
+#include "src/relax.h"
+#include "src/peephole.h"
 #include "assembler.h"
 
-const int MAX_ARGS = 3;
-const int BUF_SIZE = 1024;
-const char* IGNORE_CHARS = " \f\n\r\t\v,()";
+const int MAX_ARGS = INST_MAX_ARGS;
+const uint32_t MIN_CHUNK_SIZE = 4096;    // fewest instructions per pass two task
+const size_t MIN_SOURCE_CHUNK = 65536;   // fewest input bytes per pass one task
+const int CHUNKS_PER_THREAD = 4;
+const long DEFAULT_CACHE_MB = 256;
+const uint32_t BRANCH_REACH = 131072;    // farthest forward branch, in bytes
 
 /*******************************
  * Helper Functions
  *******************************/
 
 /* You should not be calling this function yourself. */
-static void raise_label_error(uint32_t input_line, const char* label) {
-    write_to_log("Error - invalid label at line %d: %s\n", input_line, label);
+static void raise_label_error(uint32_t input_line, Token label) {
+    write_to_log("Error - invalid label at line %d: %.*s\n", input_line,
+        (int) label.len, label.ptr);
+}
+
+/* Call this function if a label is defined a second time. */
+static void raise_duplicate_label_error(uint32_t input_line, Token label) {
+    write_to_log("Error - duplicate label at line %d: %.*s\n", input_line,
+        (int) label.len, label.ptr);
 }
 
 /* Call this function if more than MAX_ARGS arguments are found while parsing
@@ -29,90 +46,186 @@ static void raise_label_error(uint32_t input_line, const char* label) {
 
    EXTRA_ARG should contain the first extra argument encountered.
  */
-static void raise_extra_arg_error(uint32_t input_line, const char* extra_arg) {
-    write_to_log("Error - extra argument at line %d: %s\n", input_line, extra_arg);
+static void raise_extra_arg_error(uint32_t input_line, Token extra_arg) {
+    write_to_log("Error - extra argument at line %d: %.*s\n", input_line,
+        (int) extra_arg.len, extra_arg.ptr);
 }
 
-/* You should call this function if write_pass_one() or translate_inst() 
-   returns -1. 
+/* You should call this function if expand_tokens() or encode_inst() fails
+   for the instruction on LINE. If WITH_LABEL is set, the label of LINE is
+   reported as part of the instruction.
  
-   INPUT_LINE is which line of the input file that the error occurred in. Note
+   LINE->line is which line of the input file that the error occurred in. Note
    that the first line is line 1 and that empty lines are included in the count.
  */
-static void raise_inst_error(uint32_t input_line, const char* name, char** args,
-    int num_args) {
-    
-    write_to_log("Error - invalid instruction at line %d: ", input_line);
-    log_inst(name, args, num_args);
+static void raise_inst_error(const SourceLine* line, int with_label) {
+    write_to_log("Error - invalid instruction at line %d: ", line->line);
+    if (with_label) {
+        write_to_log("%.*s: ", (int) line->label.len, line->label.ptr);
+    }
+    write_to_log("%.*s", (int) line->name.len, line->name.ptr);
+    for (int i = 0; i < line->num_args; i++) {
+        write_to_log(" %.*s", (int) line->args[i].len, line->args[i].ptr);
+    }
+    write_to_log("\n");
 }
 
-/* Truncates the string at the first occurrence of the '#' character. */
-static void skip_comment(char* str) {
-    char* comment_start = strchr(str, '#');
-    if (comment_start) {
-        *comment_start = '\0';
+/* Same as raise_inst_error(), for an instruction decoded by pass one. The
+   error is reported at the input line the instruction came from.
+ */
+static void raise_decoded_inst_error(const Inst* inst) {
+    char text[INST_MAX_ARGS][64];
+    char* args[INST_MAX_ARGS];
+    for (int i = 0; i < inst->num_args; i++) {
+        format_operand(text[i], sizeof(text[i]), &inst->args[i]);
+        args[i] = text[i];
     }
+    write_to_log("Error - invalid instruction at line %d: ", inst->line);
+    log_inst(inst->name, args, inst->num_args);
 }
 
-/* Reads STR and determines whether it is a label (ends in ':'), and if so,
-   whether it is a valid label, and then tries to add it to the symbol table.
-
-   INPUT_LINE is which line of the input file we are currently processing. Note
-   that the first line is line 1 and that empty lines are included in this count.
+/* Adds the valid label LABEL, defined on INPUT_LINE, to the symbol table.
 
    BYTE_OFFSET is the offset of the NEXT instruction (should it exist). 
 
-   Four scenarios can happen:
-    1. STR is not a label (does not end in ':'). Returns 0.
-    2. STR ends in ':', but is not a valid label. Returns -1.
-    3a. STR ends in ':' and is a valid label. Addition to symbol table fails.
-        Returns -1.
-    3b. STR ends in ':' and is a valid label. Addition to symbol table succeeds.
-        Returns 1.
+   Returns 0 if the label was added, and -1 if it is already defined or the
+   addition to the symbol table failed.
  */
-static int add_if_label(uint32_t input_line, char* str, uint32_t byte_offset,
+static int add_label(uint32_t input_line, Token label, uint32_t byte_offset,
     SymbolTable* symtbl) {
     
-    size_t len = strlen(str);
-    if (str[len - 1] == ':') {
-        str[len - 1] = '\0';
-        if (is_valid_label(str)) {
-            if (add_to_table(symtbl, str, byte_offset) == 0) {
-                return 1;
-            } else {
-                return -1;
-            }
-        } else {
-            raise_label_error(input_line, str);
-            return -1;
+    if (get_addr_for_symbol_n(symtbl, label.ptr, label.len) != -1) {
+        raise_duplicate_label_error(input_line, label);
+        return -1;
+    }
+    return add_to_table_n(symtbl, label.ptr, label.len, byte_offset);
+}
+
+/* A label found by a pass one task, added to the symbol table after the tasks
+   that precede it. */
+typedef struct {
+    Token name;
+    uint32_t line;
+    uint32_t offset;        // byte offset from the start of the chunk
+    size_t log_offset;      // length of the chunk's log when it was found
+} ChunkLabel;
+
+/* The part of the input scanned by one task of pass_one_parallel(). */
+typedef struct {
+    Lexer lexer;
+    InstList* insts;
+    ChunkLabel* labels;
+    uint32_t num_labels;
+    uint32_t labels_cap;
+    LogBuffer log;
+    uint32_t newlines;
+    int ret_code;
+} PassOneChunk;
+
+/* Records a label of CHUNK, which is added to the symbol table later. */
+static void defer_label(PassOneChunk* chunk, const SourceLine* line,
+    uint32_t byte_offset) {
+    if (chunk->num_labels == chunk->labels_cap) {
+        chunk->labels_cap = chunk->labels_cap ? 2 * chunk->labels_cap : 16;
+        chunk->labels = (ChunkLabel *) realloc(chunk->labels,
+            chunk->labels_cap * sizeof(ChunkLabel));
+        if (!chunk->labels) {
+            allocation_failed();
         }
-    } else {
-        return 0;
     }
+    ChunkLabel* label = &chunk->labels[chunk->num_labels++];
+    label->name = line->label;
+    label->line = line->line;
+    label->offset = byte_offset;
+    label->log_offset = chunk->log.len;
 }
 
 /*******************************
  * Implement the Following
  *******************************/
 
-/*  A helpful helper function that parses instruction arguments. It raises an error
-    if too many arguments have been passed into the instruction.
-*/
-static int parse_args(uint32_t input_line, char** args, int* num_args) {
-    char* token;
-    while ((token = strtok(NULL, IGNORE_CHARS))) {
-        if (*num_args < MAX_ARGS) {
-            args[*num_args] = token;
-            (*num_args)++;
-        } else {
-            raise_extra_arg_error(input_line, token);
-            return -1;
+/* Reads the lines of LEXER and appends the expanded instructions to INSTS,
+   adding labels to SYMTBL, or deferring them to CHUNK if it is not NULL. If
+   OUTPUT is not NULL, the instructions of each line are written to OUTPUT as
+   text and then removed from INSTS. See pass_one() for the rules.
+ */
+static int read_pass_one(Lexer* lexer, Writer* output, InstList* insts,
+    SymbolTable* symtbl, PassOneChunk* chunk) {
+    SourceLine line;
+    uint32_t byte_offset = 0;
+    int ret_code = 0; 
+
+    // Scan lines, already stripped of comments and split into tokens
+    while (next_line(lexer, &line)) {
+        // Add the label to the symbol table. Whether or not the label is
+        // valid, the next token is the instruction name.
+        if (line.has_label) {
+            if (!is_valid_label_n(line.label.ptr, line.label.len)) {
+                raise_label_error(line.line, line.label);
+                ret_code = -1;
+            } else if (chunk) {
+                defer_label(chunk, &line, byte_offset);
+            } else if (add_label(line.line, line.label, byte_offset, symtbl) != 0) {
+                ret_code = -1;
+            }
+        }
+        if (line.name.len == 0) {
+            continue;
+        }
+
+        // An instruction with too many arguments is not written
+        if (line.extra.ptr) {
+            raise_extra_arg_error(line.line, line.extra);
+            ret_code = -1;
+            continue;
+        }
+
+        // Checks to see if there were any errors when writing instructions
+        unsigned int lines_written = expand_tokens(insts, line.line, line.name,
+            line.args, line.num_args);
+        if (lines_written == 0) {
+            raise_inst_error(&line, 0);
+            ret_code = -1;
+        } 
+        byte_offset += lines_written * 4;
+
+        if (output) {
+            for (uint32_t i = 0; i < insts->len; i++) {
+                write_inst_text(output, &insts->insts[i]);
+            }
+            clear_inst_list(insts);
         }
     }
-    return 0;
+    
+    return ret_code;
+}
+
+/* Opens a lexer over INPUT and runs read_pass_one() on it. */
+static int scan_pass_one(FILE* input, FILE* output, InstList* insts,
+    SymbolTable* symtbl) {
+    Lexer lexer;
+    if (open_lexer(&lexer, input) != 0) {
+        write_to_log("Error: unable to read input file\n");
+        return -1;
+    }
+    if (!output) {
+        int ret_code = read_pass_one(&lexer, NULL, insts, symtbl, NULL);
+        close_lexer(&lexer);
+        return ret_code;
+    }
+
+    Writer writer;
+    open_writer(&writer, output);
+    int ret_code = read_pass_one(&lexer, &writer, insts, symtbl, NULL);
+    if (close_writer(&writer) != 0) {
+        write_to_log("Error: unable to write intermediate file\n");
+        ret_code = -1;
+    }
+    close_lexer(&lexer);
+    return ret_code;
 }
 
-/* First pass of the assembler. You should implement pass_two() first.
+/* First pass of the assembler.
 
    This function should read each line, strip all comments, scan for labels,
    and pass instructions to write_pass_one(). The input file may or may not
@@ -137,124 +250,542 @@ static int parse_args(uint32_t input_line, char** args, int* num_args) {
    it should return 0.
  */
 int pass_one(FILE* input, FILE* output, SymbolTable* symtbl) {
-    char buf[BUF_SIZE];
-    uint32_t input_line = 0, byte_offset = 0;
-    int ret_code = 0; 
+    InstList* insts = create_inst_list(0);
+    int ret_code = scan_pass_one(input, output, insts, symtbl);
+    free_inst_list(insts);
+    return ret_code;
+}
 
-    // Read lines and add to instructions
-    while (fgets(buf, sizeof(buf), input) ) {
-        input_line++;
+/* Same as pass_one(), but keeps the expanded instructions in INSTS instead of
+   writing them to an intermediate file.
+ */
+int pass_one_ir(FILE* input, InstList* insts, SymbolTable* symtbl) {
+    return scan_pass_one(input, NULL, insts, symtbl);
+}
 
-        // Ignore comments
-        skip_comment(buf);
+/* Counts the lines that end in a chunk. */
+static void count_chunk_lines(void* ctx, uint32_t task) {
+    PassOneChunk* chunk = (PassOneChunk *) ctx + task;
+    const char* p = chunk->lexer.data;
+    const char* end = p + chunk->lexer.size;
+    uint32_t newlines = 0;
+    while ((p = memchr(p, '\n', end - p))) {
+        newlines++;
+        p++;
+    }
+    chunk->newlines = newlines;
+}
 
-        // Scan for the instruction name
-        char* token = strtok(buf, IGNORE_CHARS);
-        if (strcmp(buf, "") == 0){
-            continue;
-        }
-        if (token == NULL) {
-            continue;
-        }
+/* Expands a chunk with its log captured and its labels deferred. */
+static void expand_chunk(void* ctx, uint32_t task) {
+    PassOneChunk* chunk = (PassOneChunk *) ctx + task;
+    LogBuffer* previous = capture_log(&chunk->log);
+    chunk->ret_code = read_pass_one(&chunk->lexer, NULL, chunk->insts, NULL, chunk);
+    capture_log(previous);
+}
 
-        // Scan for arguments
-        char* args[MAX_ARGS + 1];
-        int num_args = 0;
-            
-        // add token to the symbol table if it is a label
-        int p = add_if_label(input_line, token, byte_offset, symtbl);
-        if (p != 0) {
-            token = strtok(NULL, IGNORE_CHARS);
-            if (token == NULL) {
-                continue;
-            }
-            char name[15];
-            strcpy(name, token);
-            //parse the instruction arguments
-            int j = parse_args(input_line, args, &num_args);
-            if (j == -1) {
-                ret_code = -1;
-            }
+/* Same as pass_one_ir(), but splits the input at line boundaries into chunks
+   that are expanded on up to NUM_THREADS threads.
 
-            // Checks to see if there were any errors when writing instructions
-            // char *name = strtok(buf, IGNORE_CHARS);
-            unsigned int lines_written = write_pass_one(output, name, args, num_args);
-            if (lines_written == 0) {
-                raise_inst_error(input_line, name, args, num_args);
-                printf("%s\n", name);
-                ret_code = -1;
-            } 
-            byte_offset += lines_written * 4;
-        } else {
-            int j = parse_args(input_line, args, &num_args);
-            if (j == -1) {
-                ret_code = -1;
+   A chunk cannot know its starting address, since that depends on how many
+   words every earlier line expands to, so labels are recorded with offsets
+   from the start of their chunk. A prefix sum over the number of words of
+   each chunk then gives the chunk addresses, and the labels are added to
+   SYMTBL in input order. Line numbers are known up front from a parallel
+   count of the lines of each chunk. The log of each chunk is captured and
+   written in input order with the duplicate label errors, so the results
+   match those of pass_one_ir().
+ */
+int pass_one_parallel(FILE* input, InstList* insts, SymbolTable* symtbl,
+    int num_threads) {
+    Lexer lexer;
+    if (open_lexer(&lexer, input) != 0) {
+        write_to_log("Error: unable to read input file\n");
+        return -1;
+    }
+
+    size_t chunk_size = lexer.size / (num_threads * CHUNKS_PER_THREAD) + 1;
+    if (chunk_size < MIN_SOURCE_CHUNK) {
+        chunk_size = MIN_SOURCE_CHUNK;
+    }
+    uint32_t num_chunks = 0, max_chunks = lexer.size / chunk_size + 1;
+    if (num_threads <= 1 || max_chunks <= 1) {
+        int ret_code = read_pass_one(&lexer, NULL, insts, symtbl, NULL);
+        close_lexer(&lexer);
+        return ret_code;
+    }
+
+    // Split the input after the first newline past every CHUNK_SIZE bytes
+    PassOneChunk* chunks = (PassOneChunk *) calloc(max_chunks, sizeof(PassOneChunk));
+    if (!chunks) {
+        allocation_failed();
+    }
+    size_t begin = 0;
+    while (begin < lexer.size) {
+        size_t end = lexer.size;
+        if (lexer.size - begin > chunk_size) {
+            const char* newline = memchr(lexer.data + begin + chunk_size, '\n',
+                lexer.size - begin - chunk_size);
+            if (newline) {
+                end = newline + 1 - lexer.data;
             }
+        }
+        slice_lexer(&chunks[num_chunks].lexer, &lexer, begin, end, 0);
+        chunks[num_chunks].insts = create_inst_list(0);
+        num_chunks++;
+        begin = end;
+    }
 
-            // Checks to see if there were any errors when writing instructions
-            char *name = strtok(buf, IGNORE_CHARS);
-            unsigned int lines_written = write_pass_one(output, name, args, num_args);
-            if (lines_written == 0) {
-                raise_inst_error(input_line, name, args, num_args);
-                printf("%s\n", name);
+    run_tasks(num_threads, num_chunks, count_chunk_lines, chunks);
+    uint32_t lines = 0;
+    for (uint32_t c = 0; c < num_chunks; c++) {
+        chunks[c].lexer.line = lines;
+        lines += chunks[c].newlines;
+    }
+
+    run_tasks(num_threads, num_chunks, expand_chunk, chunks);
+
+    // Rebase labels and merge the logs and instructions in input order
+    int ret_code = 0;
+    uint32_t base = insts->len;
+    for (uint32_t c = 0; c < num_chunks; c++) {
+        PassOneChunk* chunk = &chunks[c];
+        size_t flushed = 0;
+        for (uint32_t j = 0; j < chunk->num_labels; j++) {
+            ChunkLabel* label = &chunk->labels[j];
+            write_log_text(&chunk->log, flushed, label->log_offset);
+            flushed = label->log_offset;
+            if (add_label(label->line, label->name, 4 * base + label->offset, symtbl) != 0) {
                 ret_code = -1;
-            } 
-            byte_offset += lines_written * 4;
+            }
         }
+        write_log_text(&chunk->log, flushed, chunk->log.len);
+        if (chunk->ret_code != 0) {
+            ret_code = -1;
+        }
+
+        reserve_insts(insts, chunk->insts->len);
+        memcpy(insts->insts + base, chunk->insts->insts, chunk->insts->len * sizeof(Inst));
+        arena_adopt(&insts->strings, &chunk->insts->strings);
+        base += chunk->insts->len;
+        insts->len = base;
+
+        free_inst_list(chunk->insts);
+        free(chunk->labels);
+        free_log_buffer(&chunk->log);
     }
-    
+
+    free(chunks);
+    close_lexer(&lexer);
     return ret_code;
 }
 
-/* Reads an intermediate file and translates it into machine code. You may assume:
+/* Reads an intermediate file and translates it into machine code, appending
+   each encoded instruction to the text of OUTPUT. You may assume:
     1. The input file contains no comments
     2. The input file contains no labels
     3. The input file contains at maximum one instruction per line
     4. All instructions have at maximum MAX_ARGS arguments
-    5. The symbol table has been filled out already
+    5. The symbol table (OUTPUT->symtbl) has been filled out already
+
+   Jump targets are added to the relocation table OUTPUT->reltbl.
 
    If an error is reached, DO NOT EXIT the function. Keep translating the rest of
    the document, and at the end, return -1. Return 0 if no errors were encountered. */
-int pass_two(FILE *input, FILE* output, SymbolTable* symtbl, SymbolTable* reltbl) {
-    /* Since we pass this buffer to strtok(), the characters in this buffer will
-       GET CLOBBERED. */
-    char buf[BUF_SIZE];
-    // Store input line number / byte offset below. When should each be incremented?
-    uint32_t input_line = 0, byte_offset = 0;
+int pass_two(FILE *input, Object* output) {
+    Lexer lexer;
+    SourceLine line;
+    uint32_t byte_offset = 0;
+    int error = 0;
+
+    if (open_lexer(&lexer, input) != 0) {
+        write_to_log("Error: unable to read input file\n");
+        return -1;
+    }
+
+    while (next_line(&lexer, &line)) {
+        Inst inst;
+        uint32_t instruction;
+        if (line.has_label) {
+            // There are no labels in the intermediate file, so the leading
+            // token is an unknown instruction name
+            raise_inst_error(&line, 1);
+            error = -1;
+        } else if (line.extra.ptr) {
+            raise_extra_arg_error(line.line, line.extra);
+            error = -1;
+        } else {
+            decode_tokens(&inst, line.name, line.args, line.num_args, line.line);
+            if (encode_inst(&instruction, &inst, byte_offset, output->symtbl, output->reltbl) == -1) {
+                raise_inst_error(&line, 0);
+                error = -1;
+            } else {
+                append_word(output, instruction);
+            }
+        }
+        // Every line of the intermediate file is one word, even if it failed
+        byte_offset += 4;
+    }
+
+    close_lexer(&lexer);
+    return error;
+}
+
+/* Same as pass_two(), but encodes the instructions in INSTS produced by
+   pass_one_ir(). Instruction i is located at byte offset 4 * i, and errors are
+   reported at the input line of the original source.
+ */
+int pass_two_ir(const InstList* insts, Object* output) {
+    int error = 0;
+
+    for (uint32_t i = 0; i < insts->len; i++) {
+        const Inst* inst = &insts->insts[i];
+        uint32_t instruction;
+        if (encode_inst(&instruction, inst, 4 * i, output->symtbl, output->reltbl) == -1) {
+            raise_decoded_inst_error(inst);
+            error = -1;
+        } else {
+            append_word(output, instruction);
+        }
+    }
+    return error;
+}
+
+/* A contiguous range of instructions encoded by one task of pass_two_parallel(). */
+typedef struct {
+    const InstList* insts;
+    Object* output;
+    uint32_t begin;
+    uint32_t end;
+    SymbolTable* reltbl;    // relocations of this range only
+    uint32_t* failed;       // instructions that could not be encoded
+    uint32_t num_failed;
+    uint32_t failed_cap;
+} EncodeChunk;
+
+/* Encodes one chunk in place into the reserved text of its Object. */
+static void encode_chunk(void* ctx, uint32_t task) {
+    EncodeChunk* chunk = (EncodeChunk *) ctx + task;
+    uint32_t* text = chunk->output->text + chunk->output->len;
+
+    for (uint32_t i = chunk->begin; i < chunk->end; i++) {
+        if (encode_inst(&text[i], &chunk->insts->insts[i], 4 * i,
+            chunk->output->symtbl, chunk->reltbl) == 0) {
+            continue;
+        }
+        if (chunk->num_failed == chunk->failed_cap) {
+            chunk->failed_cap = chunk->failed_cap ? 2 * chunk->failed_cap : 16;
+            chunk->failed = (uint32_t *) realloc(chunk->failed,
+                chunk->failed_cap * sizeof(uint32_t));
+            if (!chunk->failed) {
+                allocation_failed();
+            }
+        }
+        chunk->failed[chunk->num_failed++] = i;
+    }
+}
+
+/* Same as pass_two_ir(), but splits the instructions into chunks that are
+   encoded on up to NUM_THREADS threads. The symbol table is only read during
+   pass two, so chunks share it; each keeps its own relocation table. The
+   chunks are then merged in address order, so the text, the relocation table
+   and the error log are identical to those of pass_two_ir().
+ */
+int pass_two_parallel(const InstList* insts, Object* output, int num_threads) {
+    uint32_t num_chunks = insts->len / MIN_CHUNK_SIZE;
+    if (num_chunks > (uint32_t) (num_threads * CHUNKS_PER_THREAD)) {
+        num_chunks = num_threads * CHUNKS_PER_THREAD;
+    }
+    if (num_threads <= 1 || num_chunks <= 1) {
+        return pass_two_ir(insts, output);
+    }
 
+    EncodeChunk* chunks = (EncodeChunk *) calloc(num_chunks, sizeof(EncodeChunk));
+    if (!chunks) {
+        allocation_failed();
+    }
+    for (uint32_t c = 0; c < num_chunks; c++) {
+        chunks[c].insts = insts;
+        chunks[c].output = output;
+        chunks[c].begin = (uint64_t) insts->len * c / num_chunks;
+        chunks[c].end = (uint64_t) insts->len * (c + 1) / num_chunks;
+        chunks[c].reltbl = create_table(SYMTBL_NON_UNIQUE);
+    }
+
+    reserve_words(output, insts->len);
+    run_tasks(num_threads, num_chunks, encode_chunk, chunks);
+
+    // Merge in address order, dropping the words that failed to encode
     int error = 0;
-    char* args[MAX_ARGS];
-    int num_args = 0;
-
-    // First, read the next line into a buffer.
-    while (fgets(buf, sizeof(buf), input)) {
-        input_line++;
-        // Next, use strtok() to scan for next character. If there's nothing,
-        char *token = strtok(buf, IGNORE_CHARS);
-        if (token == NULL) {
-            // go to the next line.
+    uint32_t* text = output->text + output->len;
+    uint32_t len = 0;
+    for (uint32_t c = 0; c < num_chunks; c++) {
+        EncodeChunk* chunk = &chunks[c];
+        if (chunk->num_failed == 0 && len == chunk->begin) {
+            len = chunk->end;
+        } else {
+            uint32_t next_failed = 0;
+            for (uint32_t i = chunk->begin; i < chunk->end; i++) {
+                if (next_failed < chunk->num_failed && chunk->failed[next_failed] == i) {
+                    raise_decoded_inst_error(&insts->insts[i]);
+                    error = -1;
+                    next_failed++;
+                } else {
+                    text[len++] = text[i];
+                }
+            }
+        }
+        for (uint32_t j = 0; j < chunk->reltbl->len; j++) {
+            add_to_table(output->reltbl, symbol_name(chunk->reltbl, j),
+                chunk->reltbl->tbl[j].addr);
+        }
+        free_table(chunk->reltbl);
+        free(chunk->failed);
+    }
+    output->len += len;
+
+    free(chunks);
+    return error;
+}
+
+/* A branch that assemble_stream() encoded before its label was defined. */
+typedef struct {
+    Inst inst;              // the branch, for error messages
+    char* label;            // copy of its label, which INST refers to
+    uint32_t addr;          // byte address of the branch
+    uint32_t word;          // index of its word in the output
+} Fixup;
+
+/* State of assemble_stream(). Encoded words are held in OBJECT only until
+   every branch before them is resolved, so memory grows with the distance
+   spanned by forward branches rather than with the program.
+ */
+typedef struct {
+    Object* object;         // words not yet written, starting at word BASE
+    uint32_t base;
+    uint32_t num_words;     // words encoded so far
+    Fixup* fixups;          // unresolved branches, in address order
+    uint32_t num_fixups;
+    uint32_t fixups_cap;
+} Stream;
+
+/* Records that the branch INST, encoded as the latest word of STREAM at
+   ADDR, still needs the address of its label. */
+static void add_fixup(Stream* stream, const Inst* inst, uint32_t addr) {
+    if (stream->num_fixups == stream->fixups_cap) {
+        stream->fixups_cap = stream->fixups_cap ? 2 * stream->fixups_cap : 16;
+        stream->fixups = (Fixup *) realloc(stream->fixups,
+            stream->fixups_cap * sizeof(Fixup));
+        if (!stream->fixups) {
+            allocation_failed();
+        }
+    }
+    Fixup* fixup = &stream->fixups[stream->num_fixups++];
+    const Operand* label = &inst->args[2];
+    fixup->label = strndup(label->text, label->len);
+    if (!fixup->label) {
+        allocation_failed();
+    }
+    fixup->inst = *inst;
+    fixup->inst.name = inst_desc(inst->op)->name;
+    fixup->inst.name_len = inst_desc(inst->op)->len;
+    fixup->inst.args[2].text = fixup->label;
+    fixup->addr = addr;
+    fixup->word = stream->num_words - 1;
+}
+
+/* Reports the branch of fixup I as an invalid instruction and takes its word
+   out of the output, as pass_two() leaves out instructions it cannot encode.
+   The words of the later fixups move down by one. */
+static void fail_fixup(Stream* stream, uint32_t i) {
+    Object* object = stream->object;
+    uint32_t index = stream->fixups[i].word - stream->base;
+    raise_decoded_inst_error(&stream->fixups[i].inst);
+    memmove(object->text + index, object->text + index + 1,
+        (object->len - index - 1) * sizeof(uint32_t));
+    object->len--;
+    stream->num_words--;
+    for (uint32_t j = i + 1; j < stream->num_fixups; j++) {
+        stream->fixups[j].word--;
+    }
+}
+
+/* Patches the fixups for the label NAME to branch to LABEL_ADDR and removes
+   them. Returns -1 if a branch cannot reach the label and 0 otherwise. */
+static int resolve_fixups(Stream* stream, Token name, uint32_t label_addr) {
+    int error = 0;
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < stream->num_fixups; i++) {
+        Fixup* fixup = &stream->fixups[i];
+        if (strncmp(fixup->label, name.ptr, name.len) != 0 || fixup->label[name.len] != '\0') {
+            stream->fixups[kept++] = *fixup;
             continue;
         }
-        // Parse for instruction arguments. You should use strtok() to tokenize
-        // the rest of the line. Extra arguments should be filtered out in pass_one(),
-        int j = parse_args(input_line, args, &num_args);
-        if (j == -1) {
+        uint32_t* word = &stream->object->text[fixup->word - stream->base];
+        if (patch_branch(word, fixup->addr, label_addr) != 0) {
+            fail_fixup(stream, i);
             error = -1;
         }
-        // Use translate_inst() to translate the instruction and write to output file.
-        // If an error occurs, the instruction will not be written and you should call
-        // raise_inst_error(). 
-        char *name = strtok(buf, IGNORE_CHARS);
-        // name = strtok(NULL, IGNORE_CHARS);
-        byte_offset += input_line * 4;
-        int inst = translate_inst(output, name, args, num_args, byte_offset, symtbl, reltbl);
-        if (inst == -1) {
-            raise_inst_error(input_line, name, args, num_args);
+        free(fixup->label);
+    }
+    stream->num_fixups = kept;
+    return error;
+}
+
+/* Fails the first COUNT fixups and removes them. */
+static void fail_fixups(Stream* stream, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        fail_fixup(stream, i);
+        free(stream->fixups[i].label);
+    }
+    memmove(stream->fixups, stream->fixups + count,
+        (stream->num_fixups - count) * sizeof(Fixup));
+    stream->num_fixups -= count;
+}
+
+/* Returns the number of fixups, from the first, that can no longer reach any
+   label: those more than a branch's reach before ADDR, since every label
+   still to come is at ADDR or later. */
+static uint32_t fixups_out_of_reach(const Stream* stream, uint32_t addr) {
+    uint32_t count = 0;
+    while (count < stream->num_fixups
+        && addr - stream->fixups[count].addr > BRANCH_REACH) {
+        count++;
+    }
+    return count;
+}
+
+/* Writes out the words of STREAM that precede every unresolved branch. */
+static void flush_stream(Stream* stream, Writer* writer) {
+    Object* object = stream->object;
+    uint32_t end = stream->num_fixups ? stream->fixups[0].word : stream->num_words;
+    uint32_t count = end - stream->base;
+    write_hex_words(writer, object->text, count);
+    memmove(object->text, object->text + count, (object->len - count) * sizeof(uint32_t));
+    object->len -= count;
+    stream->base = end;
+}
+
+/* Encodes INST at ADDR into STREAM. A branch to a label that is not defined
+   yet is encoded with a zero offset and patched once the label is defined.
+ */
+static int encode_streamed(Stream* stream, const Inst* inst, uint32_t addr) {
+    Object* object = stream->object;
+    int forward = inst_desc(inst->op)->format == FMT_BRANCH && inst->num_args == 3
+        && inst->args[2].kind == OPND_LABEL
+        && get_addr_for_symbol_n(object->symtbl, inst->args[2].text, inst->args[2].len) == -1;
+    uint32_t word;
+    if (encode_inst(&word, inst, addr, forward ? NULL : object->symtbl, object->reltbl) != 0) {
+        raise_decoded_inst_error(inst);
+        return -1;
+    }
+    append_word(object, word);
+    stream->num_words++;
+    if (forward) {
+        add_fixup(stream, inst, addr);
+    }
+    return 0;
+}
+
+/* Assembles INPUT into a text object on OUTPUT in a single pass, so that
+   neither has to be a file: each line is expanded and encoded as soon as it
+   is read. Branches to labels further down are encoded with a zero offset
+   and kept on a fixup list that is resolved when the label is defined, and
+   words are written out as soon as no branch before them is waiting. A
+   branch whose label is not defined within its reach is an error, so the
+   words held back never exceed the reach of a branch. Only the symbol and
+   relocation tables, which are written at the end, grow with the program.
+
+   Errors are reported like those of pass_one() and pass_two(), although
+   errors of the two passes may be interleaved. Returns 0 if there were none
+   and -1 otherwise.
+ */
+int assemble_stream(FILE* input, FILE* output) {
+    SymbolTable* symtbl = create_table(SYMTBL_UNIQUE_NAME);
+    SymbolTable* reltbl = create_table_sharing(SYMTBL_NON_UNIQUE, symtbl);
+    InstList* insts = create_inst_list(0);
+    Stream stream = {create_object(symtbl, reltbl, 0), 0, 0, NULL, 0, 0};
+    Writer writer;
+    char* buf = NULL;
+    size_t buf_size = 0;
+    ssize_t len;
+    uint32_t lines = 0, byte_offset = 0;
+    int error = 0;
+
+    open_writer(&writer, output);
+    write_string(&writer, ".text\n");
+    while ((len = getline(&buf, &buf_size, input)) != -1) {
+        Lexer lexer;
+        SourceLine line;
+        open_lexer_text(&lexer, buf, len, lines++);
+        if (!next_line(&lexer, &line)) {
+            continue;
+        }
+
+        if (line.has_label) {
+            if (!is_valid_label_n(line.label.ptr, line.label.len)) {
+                raise_label_error(line.line, line.label);
+                error = -1;
+            } else if (add_label(line.line, line.label, byte_offset, symtbl) != 0
+                || resolve_fixups(&stream, line.label, byte_offset) != 0) {
+                error = -1;
+            }
+        }
+        if (line.name.len == 0) {
+            continue;
+        }
+        if (line.extra.ptr) {
+            raise_extra_arg_error(line.line, line.extra);
+            error = -1;
+            continue;
+        }
+
+        unsigned int lines_written = expand_tokens(insts, line.line, line.name,
+            line.args, line.num_args);
+        if (lines_written == 0) {
+            raise_inst_error(&line, 0);
             error = -1;
         }
-        num_args = 0;
-        // Repeat until no more characters are left, and the return the correct return val
+        for (uint32_t i = 0; i < insts->len; i++) {
+            if (encode_streamed(&stream, &insts->insts[i], byte_offset + 4 * i) != 0) {
+                error = -1;
+            }
+        }
+        byte_offset += lines_written * 4;
+        clear_inst_list(insts);
+
+        uint32_t expired = fixups_out_of_reach(&stream, byte_offset);
+        if (expired > 0) {
+            fail_fixups(&stream, expired);
+            error = -1;
+        }
+        if (stream.object->len >= MIN_CHUNK_SIZE) {
+            flush_stream(&stream, &writer);
+        }
+    }
+    if (ferror(input)) {
+        write_to_log("Error: unable to read input file\n");
+        error = -1;
+    }
+
+    // Branches still waiting name labels that were never defined
+    if (stream.num_fixups > 0) {
+        fail_fixups(&stream, stream.num_fixups);
+        error = -1;
     }
+    flush_stream(&stream, &writer);
+    write_object_tables(&writer, stream.object);
+    if (close_writer(&writer) != 0 || fflush(output) != 0) {
+        write_to_log("Error: unable to write output file\n");
+        error = -1;
+    }
+
+    free(buf);
+    free(stream.fixups);
+    free_object(stream.object);
+    free_inst_list(insts);
+    free_table(symtbl);
+    free_table(reltbl);
     return error;
 }
 
@@ -284,21 +815,160 @@ static void close_files(FILE* input, FILE* output) {
     fclose(output);
 }
 
+/* Computes the cache key of INPUT into KEY, salted with the OPTIONS that
+   change the object. Returns 0 on success and -1 if INPUT is not cacheable.
+ */
+static int object_cache_key(char* key, FILE* input, const AssemblerOptions* options) {
+    char salt[64];
+    snprintf(salt, sizeof(salt), "format %d endian %d optimize %d local %d",
+        options->format, options->big_endian, options->optimize, options->local_jumps);
+    return cache_key(key, input, salt);
+}
+
+/* Stores the time since *MARK in *PHASE_SEC and moves *MARK to now. */
+static void end_phase(double* phase_sec, double* mark) {
+    double now = stats_clock();
+    *phase_sec = now - *mark;
+    *mark = now;
+}
+
 /* Runs the two-pass assembler. Most of the actual work is done in pass_one()
-   and pass_two().
+   and pass_two(). The object is written in the format selected by OPTIONS
+   (or as text if OPTIONS is NULL).
+
+   If TMP_NAME is NULL, both passes run in memory: pass one keeps its output
+   as an InstList that pass two encodes directly. Otherwise pass one writes
+   TMP_NAME (if IN_NAME is given) and pass two reads it (if OUT_NAME is given).
+   Only the in-memory run rewrites branches that are out of reach (see
+   relax_branches()); with an intermediate file they are errors. It also
+   optimizes the instructions of pass one if OPTIONS->optimize is set (see
+   optimize_insts()). If OPTIONS->local_jumps is set, either run encodes the
+   jumps to labels of the input itself (see resolve_local_jumps()), unless
+   there were errors.
+
+   If OPTIONS->stats is set, the in-memory run also times each phase and
+   counts lines, instructions and symbols into it. Nothing is measured
+   otherwise.
+
+   If OPTIONS->cache_dir is set, the in-memory run first looks for the object
+   of an identical input (assembled with the same options) in that cache and,
+   if it is there, copies it to OUT_NAME without running either pass. Objects
+   assembled without errors are added to the cache.
+
+   Every call has its own tables, so assemble() may run on several threads at
+   once. Returns 0 on success and 1 if there were any errors.
  */
-int assemble(const char* in_name, const char* tmp_name, const char* out_name) {
+int assemble(const char* in_name, const char* tmp_name, const char* out_name,
+    const AssemblerOptions* options) {
     FILE *src, *dst;
     int err = 0;
     SymbolTable* symtbl = create_table(SYMTBL_UNIQUE_NAME);
-    SymbolTable* reltbl = create_table(SYMTBL_NON_UNIQUE);
+    SymbolTable* reltbl = create_table_sharing(SYMTBL_NON_UNIQUE, symtbl);
+    ObjectEmitter emit_object = object_emitter(options ? options->format : OBJ_FORMAT_TEXT);
+    int big_endian = options ? options->big_endian : 0;
+    AssemblerStats* stats = options ? options->stats : NULL;
+    int local_jumps = options && options->local_jumps && options->format == OBJ_FORMAT_TEXT;
+
+    if (!tmp_name) {
+        printf("Running assembler: %s -> %s\n", in_name, out_name);
+        if (open_files(&src, &dst, in_name, out_name) != 0) {
+            free_table(symtbl);
+            free_table(reltbl);
+            return 1;
+        }
+
+        double start = 0, mark = 0;
+        if (stats) {
+            memset(stats, 0, sizeof(*stats));
+            symtbl->probes = &stats->symbol_probes;
+            start = mark = stats_clock();
+        }
+
+        char key[CACHE_KEY_SIZE];
+        const char* cache_dir = options ? options->cache_dir : NULL;
+        if (cache_dir && object_cache_key(key, src, options) != 0) {
+            cache_dir = NULL;
+        }
+        int hit = cache_dir ? cache_fetch(cache_dir, key, dst) : 0;
+        if (hit != 0) {
+            if (hit < 0 || fflush(dst) != 0) {
+                write_to_log("Error: unable to write output file: %s\n", out_name);
+                err = 1;
+            }
+            if (stats) {
+                long size = ftell(dst);
+                stats->bytes_written = size < 0 ? 0 : size;
+                stats->cache_hit = 1;
+                end_phase(&stats->write_sec, &mark);
+                stats->total_sec = mark - start;
+            }
+            close_files(src, dst);
+            free_table(symtbl);
+            free_table(reltbl);
+            return err;
+        }
+
+        InstList* insts = create_inst_list(0);
+        if (pass_one_parallel(src, insts, symtbl, options ? options->num_threads : 1) != 0) {
+            err = 1;
+        }
+        uint32_t optimized = options && options->optimize ? optimize_insts(insts, symtbl) : 0;
+        uint32_t relaxed = relax_branches(insts, symtbl);
+        if (stats) {
+            stats->optimized_insts = optimized;
+            stats->relaxed_branches = relaxed;
+            end_phase(&stats->pass_one_sec, &mark);
+        }
+
+        Object* object = create_object(symtbl, reltbl, insts->len);
+        if (pass_two_parallel(insts, object, options ? options->num_threads : 1) != 0) {
+            err = 1;
+        }
+        // Offsets past a word that failed to encode no longer match the text
+        uint32_t resolved = local_jumps && !err ? resolve_local_jumps(object) : 0;
+        if (stats) {
+            stats->local_jumps = resolved;
+            end_phase(&stats->pass_two_sec, &mark);
+        }
+
+        if (emit_object(dst, object, big_endian) != 0) {
+            write_to_log("Error: unable to write output file: %s\n", out_name);
+            err = 1;
+        }
+        if (cache_dir && !err) {
+            cache_store(cache_dir, key, emit_object, object, big_endian,
+                options->cache_max_bytes);
+        }
+
+        if (stats) {
+            fflush(dst);
+            long size = ftell(dst);
+            stats->bytes_written = size < 0 ? 0 : size;
+            end_phase(&stats->write_sec, &mark);
+            stats->total_sec = mark - start;
+            stats->symbols = symtbl->len;
+            stats->relocations = reltbl->len;
+            symtbl->probes = NULL;
+            if (count_source_stats(stats, src, insts) != 0) {
+                write_to_log("Error: unable to read input file: %s\n", in_name);
+                err = 1;
+            }
+        }
+
+        free_object(object);
+        free_inst_list(insts);
+        close_files(src, dst);
+        free_table(symtbl);
+        free_table(reltbl);
+        return err;
+    }
 
     if (in_name) {
         printf("Running pass one: %s -> %s\n", in_name, tmp_name);
         if (open_files(&src, &dst, in_name, tmp_name) != 0) {
             free_table(symtbl);
             free_table(reltbl);
-            exit(1);
+            return 1;
         }
 
         if (pass_one(src, dst, symtbl) != 0) {
@@ -312,20 +982,22 @@ int assemble(const char* in_name, const char* tmp_name, const char* out_name) {
         if (open_files(&src, &dst, tmp_name, out_name) != 0) {
             free_table(symtbl);
             free_table(reltbl);
-            exit(1);
+            return 1;
         }
 
-        fprintf(dst, ".text\n");
-        if (pass_two(src, dst, symtbl, reltbl) != 0) {
+        Object* object = create_object(symtbl, reltbl, 0);
+        if (pass_two(src, object) != 0) {
+            err = 1;
+        }
+        if (local_jumps && !err) {
+            resolve_local_jumps(object);
+        }
+        if (emit_object(dst, object, big_endian) != 0) {
+            write_to_log("Error: unable to write output file: %s\n", out_name);
             err = 1;
         }
-        
-        fprintf(dst, "\n.symbol\n");
-        write_table(symtbl, dst);
-
-        fprintf(dst, "\n.relocation\n");
-        write_table(reltbl, dst);
 
+        free_object(object);
         close_files(src, dst);
     }
     
@@ -334,61 +1006,341 @@ int assemble(const char* in_name, const char* tmp_name, const char* out_name) {
     return err;
 }
 
+typedef struct {
+    AssemblyJob* jobs;
+    AssemblerOptions options;
+} Batch;
+
+/* Assembles one job of a batch with its log captured. */
+static void run_job(void* ctx, uint32_t task) {
+    Batch* batch = (Batch *) ctx;
+    AssemblyJob* job = &batch->jobs[task];
+    AssemblerOptions options = batch->options;
+    options.stats = job->stats;
+    LogBuffer* previous = capture_log(&job->log);
+    job->err = assemble(job->in_name, NULL, job->out_name, &options);
+    capture_log(previous);
+}
+
+/* Assembles each of the NUM_JOBS JOBS in memory, running up to
+   OPTIONS->num_threads jobs at a time (each job itself runs serially). The
+   log of every job is captured and then written in job order, at the levels
+   it was logged at, followed by a line naming the input file if the job
+   failed. That line is logged whatever the error limit.
+
+   Returns the number of jobs that failed.
+ */
+uint32_t assemble_batch(AssemblyJob* jobs, uint32_t num_jobs,
+    const AssemblerOptions* options) {
+    Batch batch;
+    batch.jobs = jobs;
+    batch.options = *options;
+    batch.options.num_threads = 1;
+
+    run_tasks(options->num_threads, num_jobs, run_job, &batch);
+
+    uint32_t failed = 0;
+    for (uint32_t i = 0; i < num_jobs; i++) {
+        write_log_text(&jobs[i].log, 0, jobs[i].log.len);
+        if (jobs[i].err) {
+            log_message(LOG_SUMMARY, "Errors encountered while assembling %s\n",
+                jobs[i].in_name);
+            failed++;
+        }
+    }
+    return failed;
+}
+
+/* Appends a job for IN_NAME and OUT_NAME to JOBS, which holds *NUM_JOBS jobs
+   and has room for the next power of two. Returns the (moved) array. */
+static AssemblyJob* add_job(AssemblyJob* jobs, uint32_t* num_jobs,
+    const char* in_name, const char* out_name) {
+    if ((*num_jobs & (*num_jobs - 1)) == 0) {
+        uint32_t cap = *num_jobs ? 2 * *num_jobs : 1;
+        jobs = (AssemblyJob *) realloc(jobs, cap * sizeof(AssemblyJob));
+        if (!jobs) {
+            allocation_failed();
+        }
+    }
+    AssemblyJob* job = &jobs[(*num_jobs)++];
+    memset(job, 0, sizeof(*job));
+    job->in_name = in_name;
+    job->out_name = out_name;
+    return jobs;
+}
+
+/* Reads the jobs listed in the manifest NAME into *JOBS, one per line as an
+   input file and an output file separated by whitespace. Blank lines and text
+   after a '#' are ignored. The caller frees the file names of the jobs.
+
+   Returns the number of jobs, or -1 if the manifest is invalid.
+ */
+int read_manifest(const char* name, AssemblyJob** jobs) {
+    FILE* manifest = fopen(name, "r");
+    if (!manifest) {
+        write_to_log("Error: unable to open manifest: %s\n", name);
+        return -1;
+    }
+
+    char* buf = NULL;
+    size_t size = 0;
+    uint32_t num_jobs = 0, line = 0;
+    int ret_code = 0;
+    while (getline(&buf, &size, manifest) != -1) {
+        line++;
+        char* comment = strchr(buf, '#');
+        if (comment) {
+            *comment = '\0';
+        }
+        char* save;
+        char* files[3];
+        int num_files = 0;
+        for (char* token = strtok_r(buf, " \t\r\n", &save); token && num_files < 3;
+            token = strtok_r(NULL, " \t\r\n", &save)) {
+            files[num_files++] = token;
+        }
+        if (num_files == 2) {
+            *jobs = add_job(*jobs, &num_jobs, strdup(files[0]), strdup(files[1]));
+        } else if (num_files != 0) {
+            write_to_log("Error - invalid manifest entry at line %d\n", line);
+            ret_code = -1;
+        }
+    }
+
+    free(buf);
+    fclose(manifest);
+    return ret_code == 0 ? (int) num_jobs : -1;
+}
+
+/* Building with -DASSEMBLER_NO_MAIN leaves out the command line driver, so
+   that other programs (like bench_assembler.c) can link the passes. */
+#ifndef ASSEMBLER_NO_MAIN
+
+/* Writes the stats of the NUM_JOBS JOBS to the file NAME as JSON: a single
+   object, or an array of them for a batch. Returns 0 on success and -1 if
+   the file could not be written.
+ */
+static int write_stats_file(const char* name, const AssemblyJob* jobs,
+    uint32_t num_jobs, int batch) {
+    FILE* output = fopen(name, "w");
+    if (!output) {
+        write_to_log("Error: unable to open stats file: %s\n", name);
+        return -1;
+    }
+    if (batch) {
+        fprintf(output, "[\n");
+    }
+    for (uint32_t i = 0; i < num_jobs; i++) {
+        write_stats_json(output, jobs[i].in_name, jobs[i].stats);
+        fprintf(output, batch && i + 1 < num_jobs ? ",\n" : "\n");
+    }
+    if (batch) {
+        fprintf(output, "]\n");
+    }
+    if (fclose(output) != 0) {
+        write_to_log("Error: unable to write stats file: %s\n", name);
+        return -1;
+    }
+    return 0;
+}
+
 static void print_usage_and_exit() {
     printf("Usage:\n");
-    printf("  Runs both passes: assembler <input file> <intermediate file> <output file>\n");
+    printf("  Runs both passes: assembler <input file> <output file>\n");
+    printf("  Runs both passes through an intermediate file:\n");
+    printf("                    assembler <input file> <intermediate file> <output file>\n");
     printf("  Run pass #1:      assembler -p1 <input file> <intermediate file>\n");
     printf("  Run pass #2:      assembler -p2 <intermediate file> <output file>\n");
+    printf("  Assemble stdin to stdout in a single pass (text objects only):\n");
+    printf("                    assembler -stream\n");
+    printf("  Assemble many files:\n");
+    printf("                    assembler -batch <input file> <output file> ...\n");
+    printf("                    assembler -manifest <file listing input and output files>\n");
     printf("Append -log <file name> after any option to save log files to a text file.\n");
+    printf("Append -max-errors <n> to log at most n errors (default: all).\n");
+    printf("Append -binary to write a binary object instead of text, and\n");
+    printf("  -endian <little|big> to choose its byte order (default: little).\n");
+    printf("Append -cache <directory> to reuse the objects of unchanged inputs (not\n");
+    printf("  with an intermediate file), and -cache-size <megabytes> to bound the\n");
+    printf("  cache (default: %ld).\n", DEFAULT_CACHE_MB);
+    printf("Append -local-jumps to encode jumps to labels of the same file and list\n");
+    printf("  them under .textrel, leaving only undefined labels in .relocation (text\n");
+    printf("  objects only, and not with -stream).\n");
+    printf("Append -O to shorten pseudoinstruction expansions and remove instructions\n");
+    printf("  that change nothing (not with an intermediate file). This assumes that\n");
+    printf("  only pseudoinstructions use $at.\n");
+    printf("Append -stats <file> to save the timings and counts of assembling each\n");
+    printf("  file as JSON (not with an intermediate file).\n");
+    printf("Append -j <threads> to run on up to %d threads when running both\n", MAX_THREADS);
+    printf("  passes without an intermediate file, or to assemble that many files\n");
+    printf("  at a time in a batch.\n");
     exit(0);
 }
 
 int main(int argc, char **argv) {
-    if (argc != 4 && argc != 6) {
-        print_usage_and_exit();
+    int mode = 0;
+    char** files = (char **) malloc(argc * sizeof(char *));
+    int num_files = 0;
+    char* log_name = NULL;
+    char* manifest_name = NULL;
+    char* stats_name = NULL;
+    AssemblerOptions options = {OBJ_FORMAT_TEXT, 0, 1, NULL, NULL,
+        DEFAULT_CACHE_MB << 20, 0, 0};
+
+    if (!files) {
+        allocation_failed();
+    }
+    for (int i = 1; i < argc; i++) {
+        if (i == 1 && strcmp(argv[i], "-p1") == 0) {
+            mode = 1;
+        } else if (i == 1 && strcmp(argv[i], "-p2") == 0) {
+            mode = 2;
+        } else if (i == 1 && strcmp(argv[i], "-stream") == 0) {
+            mode = 4;
+        } else if (i == 1 && strcmp(argv[i], "-batch") == 0) {
+            mode = 3;
+        } else if (i == 1 && strcmp(argv[i], "-manifest") == 0 && i + 1 < argc) {
+            mode = 3;
+            manifest_name = argv[++i];
+        } else if (strcmp(argv[i], "-log") == 0 && i + 1 < argc) {
+            log_name = argv[++i];
+        } else if (strcmp(argv[i], "-cache") == 0 && i + 1 < argc) {
+            options.cache_dir = argv[++i];
+        } else if (strcmp(argv[i], "-cache-size") == 0 && i + 1 < argc) {
+            long int megabytes;
+            if (translate_num(&megabytes, argv[++i], 1, 1L << 24) != 0) {
+                print_usage_and_exit();
+            }
+            options.cache_max_bytes = (uint64_t) megabytes << 20;
+        } else if (strcmp(argv[i], "-stats") == 0 && i + 1 < argc) {
+            stats_name = argv[++i];
+        } else if (strcmp(argv[i], "-local-jumps") == 0) {
+            options.local_jumps = 1;
+        } else if (strcmp(argv[i], "-O") == 0) {
+            options.optimize = 1;
+        } else if (strcmp(argv[i], "-binary") == 0) {
+            options.format = OBJ_FORMAT_BINARY;
+        } else if (strcmp(argv[i], "-endian") == 0 && i + 1 < argc
+            && (strcmp(argv[i + 1], "little") == 0 || strcmp(argv[i + 1], "big") == 0)) {
+            options.big_endian = strcmp(argv[++i], "big") == 0;
+        } else if (strcmp(argv[i], "-max-errors") == 0 && i + 1 < argc) {
+            long int limit;
+            if (translate_num(&limit, argv[++i], 0, UINT32_MAX) != 0) {
+                print_usage_and_exit();
+            }
+            set_error_limit(limit);
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            long int threads;
+            if (translate_num(&threads, argv[++i], 1, MAX_THREADS) != 0) {
+                print_usage_and_exit();
+            }
+            options.num_threads = threads;
+        } else if (argv[i][0] != '-') {
+            files[num_files++] = argv[i];
+        } else {
+            print_usage_and_exit();
+        }
     }
 
-    int mode = 0;
-    if (strcmp(argv[1], "-p1") == 0) {
-        mode = 1;
-    } else if (strcmp(argv[1], "-p2") == 0) {
-        mode = 2;
-    }
-
-    char *input, *inter, *output;
-    if (mode == 1) {
-        input = argv[2];
-        inter = argv[3];
-        output = NULL;
-    } else if (mode == 2) {
-        input = NULL;
-        inter = argv[2];
-        output = argv[3];
+    char *input = NULL, *inter = NULL, *output = NULL;
+    if (mode == 1 && num_files == 2) {
+        input = files[0];
+        inter = files[1];
+    } else if (mode == 2 && num_files == 2) {
+        inter = files[0];
+        output = files[1];
+    } else if (mode == 0 && num_files == 2) {
+        input = files[0];
+        output = files[1];
+    } else if (mode == 0 && num_files == 3) {
+        input = files[0];
+        inter = files[1];
+        output = files[2];
+    } else if (mode == 3 && (manifest_name ? num_files == 0 : num_files % 2 == 0)) {
+        // Batch jobs are collected below
+    } else if (mode == 4 && num_files == 0 && options.format == OBJ_FORMAT_TEXT
+        && !stats_name && !options.cache_dir && !options.optimize
+        && !options.local_jumps) {
+        // Streams from stdin to stdout
     } else {
-        input = argv[1];
-        inter = argv[2];
-        output = argv[3];
+        print_usage_and_exit();
+    }
+    if ((stats_name || options.cache_dir || options.optimize) && inter) {
+        print_usage_and_exit();
+    }
+    if (options.local_jumps && options.format != OBJ_FORMAT_TEXT) {
+        print_usage_and_exit();
     }
 
-    if (argc == 6) {
-        if (strcmp(argv[4], "-log") == 0) {
-            set_log_file(argv[5]);
+    if (log_name) {
+        set_log_file(log_name);
+    }
+    set_log_threadsafe(options.num_threads > 1);
+
+    int err;
+    if (mode == 3) {
+        AssemblyJob* jobs = NULL;
+        uint32_t num_jobs = 0;
+        if (manifest_name) {
+            int count = read_manifest(manifest_name, &jobs);
+            num_jobs = count < 0 ? 0 : count;
+            err = count < 0;
         } else {
-            print_usage_and_exit();
+            for (int i = 0; i < num_files; i += 2) {
+                jobs = add_job(jobs, &num_jobs, files[i], files[i + 1]);
+            }
+            err = 0;
+        }
+        AssemblerStats* job_stats = NULL;
+        if (!err && stats_name) {
+            job_stats = (AssemblerStats *) calloc(num_jobs + 1, sizeof(AssemblerStats));
+            if (!job_stats) {
+                allocation_failed();
+            }
+            for (uint32_t i = 0; i < num_jobs; i++) {
+                jobs[i].stats = &job_stats[i];
+            }
+        }
+        if (!err) {
+            err = assemble_batch(jobs, num_jobs, &options) != 0;
+        }
+        if (job_stats && write_stats_file(stats_name, jobs, num_jobs, 1) != 0) {
+            err = 1;
+        }
+        free(job_stats);
+        for (uint32_t i = 0; i < num_jobs; i++) {
+            free_log_buffer(&jobs[i].log);
+            if (manifest_name) {
+                free((char *) jobs[i].in_name);
+                free((char *) jobs[i].out_name);
+            }
+        }
+        free(jobs);
+    } else if (mode == 4) {
+        err = assemble_stream(stdin, stdout) != 0;
+    } else {
+        AssemblerStats stats;
+        AssemblyJob job = {input, output, 0, {NULL, 0, 0, NULL, 0, 0}, &stats};
+        options.stats = stats_name ? &stats : NULL;
+        err = assemble(input, inter, output, &options);
+        if (stats_name && write_stats_file(stats_name, &job, 1, 0) != 0) {
+            err = 1;
         }
     }
-
-    int err = assemble(input, inter, output);
+    free(files);
 
     if (err) {
-        write_to_log("One or more errors encountered during assembly operation.\n");
+        log_message(LOG_INFO, "One or more errors encountered during assembly operation.\n");
     } else {
-        write_to_log("Assembly operation completed successfully.\n");
+        log_message(LOG_INFO, "Assembly operation completed successfully.\n");
     }
+    flush_log();
 
-    if (is_log_file_set()) {
-        printf("Results saved to %s\n", argv[5]);
+    if (is_log_file_set() && mode != 4) {
+        printf("Results saved to %s\n", log_name);
     }
 
     return err;
 }
+
+#endif
@@ -1,10 +1,48 @@
 #ifndef ASSEMBLER_H
 #define ASSEMBLER_H
 
-int assemble(const char* in_name, const char* tmp_name, const char* out_name);
+/* Options that select how assemble() runs and what it writes. */
+typedef struct {
+    int format;         // an ObjectFormat
+    int big_endian;     // byte order of binary objects
+    int num_threads;    // threads used by both passes, 1 to run them serially
+    AssemblerStats* stats;  // if not NULL, filled in when both passes run in memory
+    const char* cache_dir;  // if not NULL, objects are cached here (in memory runs only)
+    uint64_t cache_max_bytes;   // size bound of CACHE_DIR
+    int optimize;       // run optimize_insts() (in memory runs only)
+    int local_jumps;    // run resolve_local_jumps() (text objects only)
+} AssemblerOptions;
+
+/* One input file of a batch and the result of assembling it. */
+typedef struct {
+    const char* in_name;
+    const char* out_name;
+    int err;            // what assemble() returned
+    LogBuffer log;      // everything logged while assembling it
+    AssemblerStats* stats;  // if not NULL, the stats of assembling it
+} AssemblyJob;
+
+int assemble(const char* in_name, const char* tmp_name, const char* out_name,
+    const AssemblerOptions* options);
+
+uint32_t assemble_batch(AssemblyJob* jobs, uint32_t num_jobs,
+    const AssemblerOptions* options);
+
+int read_manifest(const char* name, AssemblyJob** jobs);
 
 int pass_one(FILE *input, FILE* output, SymbolTable* symtbl);
 
-int pass_two(FILE *input, FILE* output, SymbolTable* symtbl, SymbolTable* reltbl);
+int pass_two(FILE *input, Object* output);
+
+int pass_one_ir(FILE* input, InstList* insts, SymbolTable* symtbl);
+
+int pass_one_parallel(FILE* input, InstList* insts, SymbolTable* symtbl,
+    int num_threads);
+
+int pass_two_ir(const InstList* insts, Object* output);
+
+int pass_two_parallel(const InstList* insts, Object* output, int num_threads);
+
+int assemble_stream(FILE* input, FILE* output);
 
 #endif
@@ -0,0 +1,446 @@
+/* Throughput benchmark for the assembler.
+
+   Generates a synthetic MIPS source of configurable size and shape, then
+   times pass one, pass two, the symbol table and the whole of assemble()
+   separately. Each stage runs REPS times and the fastest run is reported.
+   Results are written as JSON (to bench_output.txt by default) so that runs
+   can be compared over time.
+
+   Build it like test_assembler.c, adding assembler.c compiled with
+   -DASSEMBLER_NO_MAIN so that its own main() is left out.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "src/utils.h"
+#include "src/tables.h"
+#include "src/ir.h"
+#include "src/object.h"
+#include "src/parallel.h"
+#include "src/stats.h"
+#include "src/assembler.h"
+
+const char* DEFAULT_OUTPUT = "bench_output.txt";
+
+/* Shape of the generated source. */
+typedef struct {
+    uint32_t lines;         // instructions to generate
+    uint32_t label_every;   // one label per this many instructions
+    uint32_t pseudo_pct;    // percentage of pseudoinstructions
+    uint32_t branch_pct;    // percentage of branches and jumps
+    uint32_t fanout;        // branches target labels at most this many labels away
+    uint32_t symbols;       // names inserted by the symbol table benchmark
+    uint32_t seed;
+} BenchConfig;
+
+typedef struct {
+    const char* name;
+    const char* unit;       // what COUNT counts
+    uint64_t count;
+    double best_sec;
+    long peak_rss_kb;       // peak resident set size of the process so far
+} BenchResult;
+
+/*******************************
+ * Source generator
+ *******************************/
+
+static uint32_t rng_state;
+
+/* xorshift32, so that a seed always generates the same source. */
+static uint32_t next_random() {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static const char* REGS[] = {
+    "$t0", "$t1", "$t2", "$t3", "$t4", "$t5", "$t6", "$t7",
+    "$s0", "$s1", "$s2", "$s3", "$s4", "$s5", "$s6", "$s7",
+    "$a0", "$a1", "$a2", "$a3", "$v0", "$v1", "$sp", "$ra"
+};
+
+#define NUM_REGS (sizeof(REGS) / sizeof(REGS[0]))
+
+static const char* reg() {
+    return REGS[next_random() % NUM_REGS];
+}
+
+/* Picks a label within FANOUT labels of CURRENT. */
+static uint32_t target_label(const BenchConfig* config, uint32_t current,
+    uint32_t num_labels) {
+    uint32_t span = 2 * config->fanout + 1;
+    int64_t target = (int64_t) current - config->fanout + next_random() % span;
+    if (target < 0) {
+        target = 0;
+    }
+    if (target >= num_labels) {
+        target = num_labels - 1;
+    }
+    return (uint32_t) target;
+}
+
+static void write_branch_line(FILE* f, const BenchConfig* config,
+    uint32_t current, uint32_t num_labels) {
+    uint32_t target = target_label(config, current, num_labels);
+    switch (next_random() % 4) {
+    case 0: fprintf(f, "\tbeq %s, %s, L%u\n", reg(), reg(), target); break;
+    case 1: fprintf(f, "\tbne %s, %s, L%u\n", reg(), reg(), target); break;
+    case 2: fprintf(f, "\tj L%u\n", target); break;
+    default: fprintf(f, "\tjal L%u\n", target); break;
+    }
+}
+
+static void write_pseudo_line(FILE* f, const BenchConfig* config,
+    uint32_t current, uint32_t num_labels) {
+    switch (next_random() % 8) {
+    case 0: fprintf(f, "\tli %s, %d\n", reg(), (int) (next_random() % 65536) - 32768); break;
+    case 1: fprintf(f, "\tli %s, 0x%08x\n", reg(), next_random()); break;
+    case 2: fprintf(f, "\tblt %s, %s, L%u\n", reg(), reg(),
+                target_label(config, current, num_labels)); break;
+    case 3: fprintf(f, "\tbgt %s, %s, L%u\n", reg(), reg(),
+                target_label(config, current, num_labels)); break;
+    case 4: fprintf(f, "\tswpr %s, %s\n", reg(), reg()); break;
+    case 5: fprintf(f, "\tmul %s, %s, %s\n", reg(), reg(), reg()); break;
+    case 6: fprintf(f, "\tmove %s, %s\n", reg(), reg()); break;
+    default: fprintf(f, "\trem %s, %s, %s\n", reg(), reg(), reg()); break;
+    }
+}
+
+static void write_plain_line(FILE* f) {
+    switch (next_random() % 8) {
+    case 0: fprintf(f, "\taddu %s, %s, %s\n", reg(), reg(), reg()); break;
+    case 1: fprintf(f, "\tor %s, %s, %s\n", reg(), reg(), reg()); break;
+    case 2: fprintf(f, "\tslt %s, %s, %s\n", reg(), reg(), reg()); break;
+    case 3: fprintf(f, "\tsll %s, %s, %u\n", reg(), reg(), next_random() % 32); break;
+    case 4: fprintf(f, "\taddiu %s, %s, %d\n", reg(), reg(), (int) (next_random() % 2048) - 1024); break;
+    case 5: fprintf(f, "\tori %s, %s, 0x%x\n", reg(), reg(), next_random() % 65536); break;
+    case 6: fprintf(f, "\tlw %s, %u(%s)\n", reg(), 4 * (next_random() % 256), reg()); break;
+    default: fprintf(f, "\tsw %s, %u(%s)    # store\n", reg(), 4 * (next_random() % 256), reg()); break;
+    }
+}
+
+/* Writes the benchmark source to F. Branch targets stay within a few
+   thousand instructions, so they fit the 16-bit branch offset for the
+   default shape. */
+static void generate_source(FILE* f, const BenchConfig* config) {
+    uint32_t num_labels = (config->lines + config->label_every - 1) / config->label_every;
+    rng_state = config->seed ? config->seed : 1;
+
+    fprintf(f, "# generated by bench_assembler, seed %u\n", config->seed);
+    for (uint32_t i = 0; i < config->lines; i++) {
+        uint32_t current = i / config->label_every;
+        if (i % config->label_every == 0) {
+            fprintf(f, "L%u:\n", current);
+        }
+        uint32_t pick = next_random() % 100;
+        if (pick < config->branch_pct) {
+            write_branch_line(f, config, current, num_labels);
+        } else if (pick < config->branch_pct + config->pseudo_pct) {
+            write_pseudo_line(f, config, current, num_labels);
+        } else {
+            write_plain_line(f);
+        }
+    }
+}
+
+/*******************************
+ * Timing
+ *******************************/
+
+static double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static long peak_rss_kb() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return -1;
+    }
+    return usage.ru_maxrss;
+}
+
+static void record(BenchResult* result, const char* name, const char* unit,
+    uint64_t count, double sec) {
+    if (!result->name || sec < result->best_sec) {
+        result->best_sec = sec;
+    }
+    result->name = name;
+    result->unit = unit;
+    result->count = count;
+    result->peak_rss_kb = peak_rss_kb();
+}
+
+/* Times pass_one() from IN_NAME into INTERMEDIATE. Returns the number of
+   intermediate lines written, or -1 on error. */
+static int64_t bench_pass_one(BenchResult* result, const char* in_name,
+    FILE* intermediate, uint32_t lines, int reps) {
+    int64_t num_insts = -1;
+    for (int r = 0; r < reps; r++) {
+        FILE* src = fopen(in_name, "r");
+        if (!src) {
+            return -1;
+        }
+        rewind(intermediate);
+        if (ftruncate(fileno(intermediate), 0) != 0) {
+            fclose(src);
+            return -1;
+        }
+        SymbolTable* symtbl = create_table(SYMTBL_UNIQUE_NAME);
+
+        double start = now_sec();
+        int err = pass_one(src, intermediate, symtbl);
+        double sec = now_sec() - start;
+
+        fclose(src);
+        free_table(symtbl);
+        if (err != 0) {
+            return -1;
+        }
+        record(result, "pass_one", "lines", lines, sec);
+    }
+
+    // Count the intermediate lines for pass two
+    rewind(intermediate);
+    num_insts = 0;
+    int c;
+    while ((c = getc(intermediate)) != EOF) {
+        num_insts += c == '\n';
+    }
+    return num_insts;
+}
+
+/* Times pass_two() over INTERMEDIATE, using the symbols of IN_NAME. */
+static int bench_pass_two(BenchResult* result, const char* in_name,
+    FILE* intermediate, uint32_t num_insts, int reps) {
+    FILE* src = fopen(in_name, "r");
+    if (!src) {
+        return -1;
+    }
+    SymbolTable* symtbl = create_table(SYMTBL_UNIQUE_NAME);
+    InstList* insts = create_inst_list(0);
+    int err = pass_one_ir(src, insts, symtbl);
+    free_inst_list(insts);
+    fclose(src);
+
+    for (int r = 0; r < reps && err == 0; r++) {
+        SymbolTable* reltbl = create_table_sharing(SYMTBL_NON_UNIQUE, symtbl);
+        Object* object = create_object(symtbl, reltbl, num_insts);
+        rewind(intermediate);
+
+        double start = now_sec();
+        err = pass_two(intermediate, object);
+        double sec = now_sec() - start;
+
+        free_object(object);
+        free_table(reltbl);
+        record(result, "pass_two", "lines", num_insts, sec);
+    }
+    free_table(symtbl);
+    return err;
+}
+
+/* Times add_to_table() and get_addr_for_symbol() over COUNT distinct names. */
+static void bench_symbols(BenchResult* insert, BenchResult* lookup,
+    uint32_t count, int reps) {
+    char** names = (char **) malloc(count * sizeof(char *));
+    if (!names) {
+        allocation_failed();
+    }
+    char buf[32];
+    for (uint32_t i = 0; i < count; i++) {
+        snprintf(buf, sizeof(buf), "sym_%u_%x", i, i * 2654435761u);
+        names[i] = strdup(buf);
+        if (!names[i]) {
+            allocation_failed();
+        }
+    }
+
+    for (int r = 0; r < reps; r++) {
+        SymbolTable* table = create_table(SYMTBL_UNIQUE_NAME);
+
+        double start = now_sec();
+        for (uint32_t i = 0; i < count; i++) {
+            add_to_table(table, names[i], 4 * i);
+        }
+        double mid = now_sec();
+        int64_t sum = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            sum += get_addr_for_symbol(table, names[(i * 7919u) % count]);
+        }
+        double end = now_sec();
+
+        if (sum < 0) {
+            fprintf(stderr, "bench_assembler: symbol lookup failed\n");
+        }
+        record(insert, "add_to_table", "symbols", count, mid - start);
+        record(lookup, "get_addr_for_symbol", "lookups", count, end - mid);
+        free_table(table);
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        free(names[i]);
+    }
+    free(names);
+}
+
+/* Times assemble() end to end, writing the object to /dev/null. */
+static int bench_assemble(BenchResult* result, const char* in_name, uint32_t lines,
+    int num_threads, int reps) {
+    AssemblerOptions options = {OBJ_FORMAT_TEXT, 0, num_threads, NULL, NULL, 0, 0, 0};
+    for (int r = 0; r < reps; r++) {
+        double start = now_sec();
+        int err = assemble(in_name, NULL, "/dev/null", &options);
+        double sec = now_sec() - start;
+        if (err != 0) {
+            return -1;
+        }
+        record(result, "assemble", "lines", lines, sec);
+    }
+    return 0;
+}
+
+static void write_results(FILE* f, const BenchConfig* config, int reps,
+    int num_threads, const BenchResult* results, int num_results) {
+    fprintf(f, "{\n");
+    fprintf(f, "  \"config\": {\"lines\": %u, \"label_every\": %u, \"pseudo_pct\": %u, "
+        "\"branch_pct\": %u, \"fanout\": %u, \"symbols\": %u, \"seed\": %u, "
+        "\"reps\": %d, \"threads\": %d},\n", config->lines, config->label_every,
+        config->pseudo_pct, config->branch_pct, config->fanout, config->symbols,
+        config->seed, reps, num_threads);
+    fprintf(f, "  \"results\": [\n");
+    for (int i = 0; i < num_results; i++) {
+        const BenchResult* r = &results[i];
+        double rate = r->best_sec > 0 ? r->count / r->best_sec : 0;
+        fprintf(f, "    {\"name\": \"%s\", \"%s\": %llu, \"best_sec\": %.6f, "
+            "\"%s_per_sec\": %.0f, \"peak_rss_kb\": %ld}%s\n", r->name, r->unit,
+            (unsigned long long) r->count, r->best_sec, r->unit, rate,
+            r->peak_rss_kb, i + 1 < num_results ? "," : "");
+    }
+    fprintf(f, "  ],\n");
+    fprintf(f, "  \"peak_rss_kb\": %ld\n", peak_rss_kb());
+    fprintf(f, "}\n");
+}
+
+static void print_usage_and_exit() {
+    printf("Usage: bench_assembler [options]\n");
+    printf("  -lines <n>        instructions to generate (default: 200000)\n");
+    printf("  -label-every <n>  one label per n instructions (default: 8)\n");
+    printf("  -pseudo <pct>     percentage of pseudoinstructions (default: 25)\n");
+    printf("  -branches <pct>   percentage of branches and jumps (default: 15)\n");
+    printf("  -fanout <n>       branch targets at most n labels away (default: 16)\n");
+    printf("  -symbols <n>      names for the symbol table benchmark (default: 200000)\n");
+    printf("  -seed <n>         generator seed (default: 1)\n");
+    printf("  -reps <n>         runs per benchmark, the fastest is kept (default: 3)\n");
+    printf("  -j <threads>      threads for assemble() (default: 1)\n");
+    printf("  -keep <file>      keep the generated source in file\n");
+    printf("  -o <file>         JSON results file (default: %s)\n", DEFAULT_OUTPUT);
+    exit(0);
+}
+
+int main(int argc, char** argv) {
+    BenchConfig config = {200000, 8, 25, 15, 16, 200000, 1};
+    int reps = 3;
+    int num_threads = 1;
+    const char* keep_name = NULL;
+    const char* out_name = DEFAULT_OUTPUT;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            print_usage_and_exit();
+        }
+        const char* opt = argv[i];
+        const char* val = argv[++i];
+        uint32_t n = (uint32_t) strtoul(val, NULL, 0);
+        if (strcmp(opt, "-lines") == 0 && n > 0) {
+            config.lines = n;
+        } else if (strcmp(opt, "-label-every") == 0 && n > 0) {
+            config.label_every = n;
+        } else if (strcmp(opt, "-pseudo") == 0 && n <= 100) {
+            config.pseudo_pct = n;
+        } else if (strcmp(opt, "-branches") == 0 && n <= 100) {
+            config.branch_pct = n;
+        } else if (strcmp(opt, "-fanout") == 0) {
+            config.fanout = n;
+        } else if (strcmp(opt, "-symbols") == 0 && n > 0) {
+            config.symbols = n;
+        } else if (strcmp(opt, "-seed") == 0) {
+            config.seed = n;
+        } else if (strcmp(opt, "-reps") == 0 && n > 0) {
+            reps = (int) n;
+        } else if (strcmp(opt, "-j") == 0 && n > 0 && n <= MAX_THREADS) {
+            num_threads = (int) n;
+        } else if (strcmp(opt, "-keep") == 0) {
+            keep_name = val;
+        } else if (strcmp(opt, "-o") == 0) {
+            out_name = val;
+        } else {
+            print_usage_and_exit();
+        }
+    }
+    if (config.pseudo_pct + config.branch_pct > 100) {
+        print_usage_and_exit();
+    }
+
+    char tmp_name[] = "/tmp/bench_assembler_XXXXXX";
+    const char* in_name = keep_name;
+    FILE* src;
+    if (keep_name) {
+        src = fopen(keep_name, "w");
+    } else {
+        int fd = mkstemp(tmp_name);
+        src = fd >= 0 ? fdopen(fd, "w") : NULL;
+        in_name = tmp_name;
+    }
+    if (!src) {
+        fprintf(stderr, "bench_assembler: unable to create the source file\n");
+        return 1;
+    }
+    generate_source(src, &config);
+    fclose(src);
+
+    FILE* intermediate = tmpfile();
+    if (!intermediate) {
+        fprintf(stderr, "bench_assembler: unable to create the intermediate file\n");
+        return 1;
+    }
+
+    BenchResult results[5];
+    memset(results, 0, sizeof(results));
+    int err = 0;
+
+    bench_symbols(&results[0], &results[1], config.symbols, reps);
+    int64_t num_insts = bench_pass_one(&results[2], in_name, intermediate,
+        config.lines, reps);
+    if (num_insts < 0 || bench_pass_two(&results[3], in_name, intermediate,
+            (uint32_t) num_insts, reps) != 0
+        || bench_assemble(&results[4], in_name, config.lines, num_threads, reps) != 0) {
+        fprintf(stderr, "bench_assembler: the generated source did not assemble\n");
+        err = 1;
+    }
+    fclose(intermediate);
+    if (!keep_name) {
+        unlink(tmp_name);
+    }
+    if (err) {
+        return 1;
+    }
+
+    FILE* out = fopen(out_name, "w");
+    if (!out) {
+        fprintf(stderr, "bench_assembler: unable to write %s\n", out_name);
+        return 1;
+    }
+    write_results(out, &config, reps, num_threads, results, 5);
+    fclose(out);
+    write_results(stdout, &config, reps, num_threads, results, 5);
+    return 0;
+}
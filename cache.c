@@ -0,0 +1,246 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "utils.h"
+#include "tables.h"
+#include "object.h"
+#include "lexer.h"
+#include "cache.h"
+
+/* Part of every key. Bump it whenever the assembler starts producing
+   different output for the same input, so that stale objects are missed. */
+#define CACHE_VERSION "1"
+
+#define COPY_CHUNK 65536
+#define STALE_TMP_SEC 3600      // age after which a temporary file is abandoned
+
+/* The cache directory holds one file per object, named after its key with
+   an ".obj" suffix and holding exactly the bytes of the object file.
+
+   Processes may share the directory. An object is written to a temporary
+   file ("tmp-" followed by the key) and renamed into place, so readers only
+   ever see complete objects, and two processes storing the same key simply
+   replace one copy with an identical one. The modification time of an
+   object is its last use: a hit touches it, and eviction removes the least
+   recently used objects first. Removing an object that another process is
+   reading is safe, since the reader keeps its open file.
+ */
+
+typedef struct {
+    char* name;
+    struct timespec mtime;
+    uint64_t size;
+} CacheEntry;
+
+/* Sets the modification time of the file FD to now. The time is read from
+   the clock rather than left to the file system, whose timestamps may be too
+   coarse to order uses that are close together. */
+static void touch(int fd) {
+    struct timespec times[2];
+    clock_gettime(CLOCK_REALTIME, &times[1]);
+    times[0].tv_sec = 0;
+    times[0].tv_nsec = UTIME_OMIT;
+    futimens(fd, times);
+}
+
+/* FNV-1a over the LEN bytes at DATA, continuing from H. */
+static uint64_t hash_bytes(uint64_t h, const char* data, size_t len) {
+    const unsigned char* p = (const unsigned char *) data;
+    const unsigned char* end = p + len;
+    while (p < end) {
+        h ^= *p++;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+/* Computes the key of INPUT into KEY, which must hold CACHE_KEY_SIZE
+   characters. SALT names everything besides the input that changes the
+   output (like the object format). The key is two 64-bit hashes with
+   different seeds, which keeps accidental collisions out of reach.
+
+   The whole of INPUT is hashed, and it is left rewound. Only regular files
+   are cached, since the input is read twice on a miss. Returns 0 on success
+   and -1 if INPUT cannot be cached.
+ */
+int cache_key(char* key, FILE* input, const char* salt) {
+    struct stat st;
+    Lexer lexer;
+
+    rewind(input);
+    if (fstat(fileno(input), &st) != 0 || !S_ISREG(st.st_mode)
+        || open_lexer(&lexer, input) != 0) {
+        rewind(input);
+        return -1;
+    }
+    uint64_t h1 = 14695981039346656037ull, h2 = 0x9e3779b97f4a7c15ull;
+    h1 = hash_bytes(h1, CACHE_VERSION, strlen(CACHE_VERSION) + 1);
+    h2 = hash_bytes(h2, CACHE_VERSION, strlen(CACHE_VERSION) + 1);
+    h1 = hash_bytes(h1, salt, strlen(salt) + 1);
+    h2 = hash_bytes(h2, salt, strlen(salt) + 1);
+    h1 = hash_bytes(h1, lexer.data, lexer.size);
+    h2 = hash_bytes(h2, lexer.data, lexer.size);
+    close_lexer(&lexer);
+    rewind(input);
+
+    snprintf(key, CACHE_KEY_SIZE, "%016llx%016llx", (unsigned long long) h1,
+        (unsigned long long) h2);
+    return 0;
+}
+
+/* Copies the cached object for KEY in DIR to OUTPUT and marks it as just
+   used. Returns 1 on a hit, 0 on a miss and -1 if OUTPUT could not be
+   written.
+ */
+int cache_fetch(const char* dir, const char* key, FILE* output) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s.obj", dir, key);
+    FILE* cached = fopen(path, "rb");
+    if (!cached) {
+        return 0;
+    }
+
+    char* buf = (char *) malloc(COPY_CHUNK);
+    if (!buf) {
+        allocation_failed();
+    }
+    int ret = 1;
+    size_t n;
+    while ((n = fread(buf, 1, COPY_CHUNK, cached)) > 0) {
+        if (fwrite(buf, 1, n, output) != n) {
+            ret = -1;
+            break;
+        }
+    }
+    if (ret == 1 && ferror(cached)) {
+        // Written in part already, so it cannot be treated as a miss
+        ret = -1;
+    }
+    if (ret == 1) {
+        touch(fileno(cached));
+    }
+    free(buf);
+    fclose(cached);
+    return ret;
+}
+
+static int compare_entries(const void* a, const void* b) {
+    const struct timespec* ta = &((const CacheEntry *) a)->mtime;
+    const struct timespec* tb = &((const CacheEntry *) b)->mtime;
+    if (ta->tv_sec != tb->tv_sec) {
+        return ta->tv_sec < tb->tv_sec ? -1 : 1;
+    }
+    return ta->tv_nsec < tb->tv_nsec ? -1 : ta->tv_nsec > tb->tv_nsec;
+}
+
+/* Removes the least recently used objects of DIR until they add up to at
+   most MAX_BYTES, along with temporary files abandoned by processes that
+   died while storing. Files that another process removes first are skipped.
+ */
+static void evict(const char* dir, uint64_t max_bytes) {
+    DIR* d = opendir(dir);
+    if (!d) {
+        return;
+    }
+    CacheEntry* entries = NULL;
+    uint32_t len = 0, cap = 0;
+    uint64_t total = 0;
+    time_t now = time(NULL);
+    char path[4096];
+    struct dirent* ent;
+
+    while ((ent = readdir(d))) {
+        size_t name_len = strlen(ent->d_name);
+        int is_tmp = strncmp(ent->d_name, "tmp-", 4) == 0;
+        int is_obj = name_len > 4 && strcmp(ent->d_name + name_len - 4, ".obj") == 0;
+        struct stat st;
+        if (!is_tmp && !is_obj) {
+            continue;
+        }
+        snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+        if (stat(path, &st) != 0) {
+            continue;
+        }
+        if (is_tmp) {
+            if (now - st.st_mtime > STALE_TMP_SEC) {
+                unlink(path);
+            }
+            continue;
+        }
+        if (len == cap) {
+            cap = cap ? 2 * cap : 64;
+            entries = (CacheEntry *) realloc(entries, cap * sizeof(CacheEntry));
+            if (!entries) {
+                allocation_failed();
+            }
+        }
+        entries[len].name = strdup(ent->d_name);
+        if (!entries[len].name) {
+            allocation_failed();
+        }
+        entries[len].mtime = st.st_mtim;
+        entries[len].size = st.st_size;
+        total += st.st_size;
+        len++;
+    }
+    closedir(d);
+
+    qsort(entries, len, sizeof(CacheEntry), compare_entries);
+    for (uint32_t i = 0; i < len; i++) {
+        if (total > max_bytes) {
+            snprintf(path, sizeof(path), "%s/%s", dir, entries[i].name);
+            unlink(path);
+            total -= entries[i].size;
+        }
+        free(entries[i].name);
+    }
+    free(entries);
+}
+
+/* Stores OBJECT, serialized by EMIT, as the cached object for KEY in DIR,
+   creating DIR if needed, and then evicts objects to keep DIR within
+   MAX_BYTES. A failure to store is logged as a warning, since assembly
+   itself has succeeded.
+
+   Returns 0 on success and -1 if the object could not be stored.
+ */
+int cache_store(const char* dir, const char* key, ObjectEmitter emit,
+    const Object* object, int big_endian, uint64_t max_bytes) {
+    char tmp_path[4096], path[4096];
+
+    if (mkdir(dir, 0777) != 0 && errno != EEXIST) {
+        log_message(LOG_WARNING, "Warning: unable to create cache directory: %s\n", dir);
+        return -1;
+    }
+    snprintf(tmp_path, sizeof(tmp_path), "%s/tmp-%s-XXXXXX", dir, key);
+    snprintf(path, sizeof(path), "%s/%s.obj", dir, key);
+
+    int fd = mkstemp(tmp_path);
+    FILE* output = fd >= 0 ? fdopen(fd, "wb") : NULL;
+    if (!output) {
+        if (fd >= 0) {
+            close(fd);
+            unlink(tmp_path);
+        }
+        log_message(LOG_WARNING, "Warning: unable to write cache directory: %s\n", dir);
+        return -1;
+    }
+    int err = emit(output, object, big_endian) != 0;
+    err |= fflush(output) != 0;
+    touch(fd);
+    err |= fclose(output) != 0;
+    if (err || rename(tmp_path, path) != 0) {
+        unlink(tmp_path);
+        log_message(LOG_WARNING, "Warning: unable to write cache directory: %s\n", dir);
+        return -1;
+    }
+
+    evict(dir, max_bytes);
+    return 0;
+}
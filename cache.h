@@ -0,0 +1,27 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "tables.h"
+#include "object.h"
+
+/* An on-disk cache of assembled objects, keyed by a hash of the input file
+   and of everything else that changes the output. See cache.c for the layout
+   of the cache directory and how processes share it.
+ */
+
+#define CACHE_KEY_SIZE 33       // 32 hex digits and a NUL
+
+/* See documentation in cache.c */
+int cache_key(char* key, FILE* input, const char* salt);
+
+/* See documentation in cache.c */
+int cache_fetch(const char* dir, const char* key, FILE* output);
+
+/* See documentation in cache.c */
+int cache_store(const char* dir, const char* key, ObjectEmitter emit,
+    const Object* object, int big_endian, uint64_t max_bytes);
+
+#endif
@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tables.h"
+#include "intern.h"
+
+#define INITIAL_SIZE 16
+#define SCALING_FACTOR 2
+#define AVERAGE_NAME_SIZE 16      // bytes of name storage reserved per name
+#define MIN_ARENA_BLOCK 4096
+
+/* Creates an empty Interner with room for about CAPACITY names, holding one
+   reference to it. */
+Interner* create_interner(uint32_t capacity) {
+    Interner* interner = (Interner *) malloc(sizeof(Interner));
+    if (!interner) {
+        allocation_failed();
+    }
+    if (capacity < INITIAL_SIZE) {
+        capacity = INITIAL_SIZE;
+    }
+    interner->strings = (char **) malloc(capacity * sizeof(char *));
+    uint32_t index_cap = INITIAL_SIZE;
+    while (index_cap < 2 * capacity) {
+        index_cap *= SCALING_FACTOR;
+    }
+    interner->index = (uint32_t *) calloc(index_cap, sizeof(uint32_t));
+    if (!interner->strings || !interner->index) {
+        allocation_failed();
+    }
+    interner->len = 0;
+    interner->cap = capacity;
+    interner->index_cap = index_cap;
+    interner->refs = 1;
+    arena_init(&interner->arena, capacity * AVERAGE_NAME_SIZE < MIN_ARENA_BLOCK ?
+        MIN_ARENA_BLOCK : capacity * AVERAGE_NAME_SIZE);
+    return interner;
+}
+
+/* Takes another reference to INTERNER and returns it. */
+Interner* share_interner(Interner* interner) {
+    interner->refs++;
+    return interner;
+}
+
+/* Drops one reference to INTERNER, and frees it and every name it holds
+   along with the last one. */
+void free_interner(Interner* interner) {
+    if (--interner->refs > 0) {
+        return;
+    }
+    arena_release(&interner->arena);
+    free(interner->index);
+    free(interner->strings);
+    free(interner);
+}
+
+const char* interned_name(const Interner* interner, uint32_t id) {
+    return interner->strings[id];
+}
+
+/* FNV-1a hash of the LEN characters at NAME. */
+static uint32_t hash_name(const char* name, size_t len) {
+    uint32_t h = 2166136261u;
+    const char* end = name + len;
+    while (name < end) {
+        h ^= (unsigned char) *name++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* Returns the index slot for the LEN characters at NAME: either the slot
+   holding its ID, or the empty slot where the ID would be inserted.
+
+   If PROBES is set, the number of slots examined is added to it. Lookups may
+   run on several threads at once (as in pass two), so the count is added
+   atomically, once per call.
+ */
+static uint32_t* find_slot(const Interner* interner, const char* name, size_t len,
+    uint64_t* probes) {
+    uint32_t mask = interner->index_cap - 1;
+    uint32_t i = hash_name(name, len) & mask;
+    uint32_t count = 1;
+    while (interner->index[i] != 0) {
+        const char* candidate = interner->strings[interner->index[i] - 1];
+        if (strncmp(candidate, name, len) == 0 && candidate[len] == '\0') {
+            break;
+        }
+        i = (i + 1) & mask;
+        count++;
+    }
+    if (probes) {
+        __atomic_fetch_add(probes, count, __ATOMIC_RELAXED);
+    }
+    return &interner->index[i];
+}
+
+/* Doubles the number of index slots and reinserts every name. */
+static void grow_index(Interner* interner) {
+    free(interner->index);
+    interner->index_cap *= SCALING_FACTOR;
+    interner->index = (uint32_t *) calloc(interner->index_cap, sizeof(uint32_t));
+    if (!interner->index) {
+        allocation_failed();
+    }
+    for (uint32_t id = 0; id < interner->len; id++) {
+        const char* name = interner->strings[id];
+        *find_slot(interner, name, strlen(name), NULL) = id + 1;
+    }
+}
+
+/* Returns the ID of the LEN characters at NAME (which need not be
+   NUL-terminated), giving it the next free ID if it is new. Adds the index
+   slots examined to PROBES if it is set. Not safe to call while other
+   threads use INTERNER.
+ */
+uint32_t intern_name(Interner* interner, const char* name, size_t len, uint64_t* probes) {
+    /** Keep the index at most half full so probe sequences stay short. **/
+    if (2 * (interner->len + 1) > interner->index_cap) {
+        grow_index(interner);
+    }
+    uint32_t* slot = find_slot(interner, name, len, probes);
+    if (*slot != 0) {
+        return *slot - 1;
+    }
+
+    if (interner->len == interner->cap) {
+        interner->cap *= SCALING_FACTOR;
+        interner->strings = (char **) realloc(interner->strings,
+            interner->cap * sizeof(char *));
+        if (!interner->strings) {
+            allocation_failed();
+        }
+    }
+    interner->strings[interner->len] = arena_strndup(&interner->arena, name, len);
+    *slot = ++interner->len;
+    return interner->len - 1;
+}
+
+/* Returns the ID of the LEN characters at NAME, or -1 if NAME was never
+   interned. Adds the index slots examined to PROBES if it is set. Only
+   reads INTERNER, so it may run on several threads at once.
+ */
+int64_t find_name(const Interner* interner, const char* name, size_t len, uint64_t* probes) {
+    uint32_t slot = *find_slot(interner, name, len, probes);
+    return slot == 0 ? -1 : (int64_t) slot - 1;
+}
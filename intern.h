@@ -0,0 +1,44 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arena.h"
+
+/* Gives every distinct name a small integer ID, numbered from 0 in the order
+   the names were first seen, and keeps one copy of each name. Tables that
+   share an Interner refer to the same name by the same ID, so they can
+   compare IDs instead of strings. An Interner is shared by counting its
+   users: create_interner() and share_interner() each take a reference, and
+   free_interner() drops one.
+ */
+typedef struct {
+    char** strings;         // NUL-terminated name of each ID
+    uint32_t len;           // number of IDs handed out
+    uint32_t cap;
+    uint32_t* index;        // open-addressing hash index, slots hold ID + 1
+    uint32_t index_cap;     // number of slots, always a power of two
+    Arena arena;            // storage for every name
+    int refs;
+} Interner;
+
+/* See documentation in intern.c */
+Interner* create_interner(uint32_t capacity);
+
+/* See documentation in intern.c */
+Interner* share_interner(Interner* interner);
+
+/* See documentation in intern.c */
+void free_interner(Interner* interner);
+
+/* See documentation in intern.c */
+uint32_t intern_name(Interner* interner, const char* name, size_t len, uint64_t* probes);
+
+/* See documentation in intern.c */
+int64_t find_name(const Interner* interner, const char* name, size_t len, uint64_t* probes);
+
+/* Returns the name that INTERNER gave the ID ID. */
+const char* interned_name(const Interner* interner, uint32_t id);
+
+#endif
@@ -0,0 +1,73 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tables.h"
+#include "ir.h"
+
+#define MIN_CAPACITY 16
+#define STRINGS_BLOCK_SIZE 4096
+
+InstList* create_inst_list(uint32_t capacity) {
+    InstList* list = (InstList *) malloc(sizeof(InstList));
+    if (!list) {
+        allocation_failed();
+    }
+    if (capacity < MIN_CAPACITY) {
+        capacity = MIN_CAPACITY;
+    }
+    list->insts = (Inst *) malloc(capacity * sizeof(Inst));
+    if (!list->insts) {
+        allocation_failed();
+    }
+    list->len = 0;
+    list->cap = capacity;
+    arena_init(&list->strings, STRINGS_BLOCK_SIZE);
+    return list;
+}
+
+void free_inst_list(InstList* list) {
+    arena_release(&list->strings);
+    free(list->insts);
+    free(list);
+}
+
+void clear_inst_list(InstList* list) {
+    arena_release(&list->strings);
+    list->len = 0;
+}
+
+void reserve_insts(InstList* list, uint32_t count) {
+    if (list->cap - list->len >= count) {
+        return;
+    }
+    while (list->cap - list->len < count) {
+        list->cap *= 2;
+    }
+    list->insts = (Inst *) realloc(list->insts, list->cap * sizeof(Inst));
+    if (!list->insts) {
+        allocation_failed();
+    }
+}
+
+void append_inst(InstList* list, const Inst* inst) {
+    if (list->len == list->cap) {
+        list->cap *= 2;
+        list->insts = (Inst *) realloc(list->insts, list->cap * sizeof(Inst));
+        if (!list->insts) {
+            allocation_failed();
+        }
+    }
+
+    Inst* copy = &list->insts[list->len++];
+    *copy = *inst;
+    if (copy->op == INST_UNKNOWN) {
+        copy->name = arena_strndup(&list->strings, inst->name, inst->name_len);
+    }
+    for (int i = 0; i < copy->num_args; i++) {
+        if (copy->args[i].text) {
+            copy->args[i].text = arena_strndup(&list->strings, inst->args[i].text,
+                inst->args[i].len);
+        }
+    }
+}
@@ -0,0 +1,110 @@
+#ifndef IR_H
+#define IR_H
+
+#include <stdint.h>
+
+#include "arena.h"
+
+/* In-memory representation of the instructions produced by pass one. Each
+   entry is a single machine instruction (pseudoinstructions are already
+   expanded) with its opcode decoded and its operands parsed, so pass two can
+   encode it without looking at any text.
+ */
+
+#define INST_MAX_ARGS 3
+
+/* Every mnemonic the assembler knows, in the order of the descriptor table in
+   translate.c. Only real instructions (up to INST_MFHI) appear in an InstList;
+   INST_UNKNOWN keeps the mnemonic text so that pass two can report it.
+ */
+typedef enum {
+    INST_UNKNOWN = 0,
+    INST_ADDU,
+    INST_OR,
+    INST_SLT,
+    INST_SLTU,
+    INST_SLL,
+    INST_JR,
+    INST_ADDIU,
+    INST_ORI,
+    INST_LUI,
+    INST_LB,
+    INST_LW,
+    INST_LBU,
+    INST_SB,
+    INST_SW,
+    INST_BEQ,
+    INST_BNE,
+    INST_J,
+    INST_JAL,
+    INST_ADD,
+    INST_MULT,
+    INST_DIV,
+    INST_MFLO,
+    INST_MFHI,
+    INST_LI,
+    INST_MOVE,
+    INST_BLT,
+    INST_BGT,
+    INST_TRADDU,
+    INST_SWPR,
+    INST_MUL,
+    INST_REM,
+    NUM_INST_OPS
+} InstOp;
+
+typedef enum {
+    OPND_REG,       // VALUE is a register number
+    OPND_IMM,       // VALUE is an immediate
+    OPND_LABEL,     // TEXT is a valid label name
+    OPND_BAD,       // TEXT could not be parsed as any of the above
+    OPND_OFFSET     // VALUE is a branch offset in words (only made by relax.c)
+} OperandKind;
+
+/* A view of LEN characters of source text. It is not NUL-terminated. */
+typedef struct {
+    const char* ptr;
+    uint32_t len;
+} Token;
+
+typedef struct {
+    int kind;
+    uint32_t len;           // strlen(text), which need not be NUL-terminated
+    long int value;
+    const char* text;
+} Operand;
+
+typedef struct {
+    int op;                 // an InstOp
+    uint32_t name_len;      // strlen(name), which need not be NUL-terminated
+    const char* name;       // mnemonic, used for error messages
+    uint32_t line;          // input line the instruction came from
+    int num_args;
+    Operand args[INST_MAX_ARGS];
+} Inst;
+
+typedef struct {
+    Inst* insts;
+    uint32_t len;
+    uint32_t cap;
+    Arena strings;          // copies of label names and unparsed operands
+} InstList;
+
+/* Creates an empty InstList with room for CAPACITY instructions. */
+InstList* create_inst_list(uint32_t capacity);
+
+/* Frees the InstList and all associated memory. */
+void free_inst_list(InstList* list);
+
+/* Removes every instruction from LIST, keeping the instruction array. */
+void clear_inst_list(InstList* list);
+
+/* Makes room for COUNT more instructions after the end of LIST. */
+void reserve_insts(InstList* list, uint32_t count);
+
+/* Appends a copy of INST to LIST. Any operand or mnemonic text that INST
+   points to is copied into LIST (and NUL-terminated), so INST may refer to
+   temporary buffers or to token views of the source. */
+void append_inst(InstList* list, const Inst* inst);
+
+#endif
@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "tables.h"
+#include "lexer.h"
+
+#define READ_CHUNK 65536
+
+/* Character classes used by the scanner. Delimiters are the characters that
+   pass one used to hand to strtok(): " \f\n\r\t\v,()".
+ */
+enum {
+    CHAR_TOKEN = 0,
+    CHAR_DELIM,
+    CHAR_NEWLINE,
+    CHAR_COMMENT
+};
+
+static const unsigned char CHAR_CLASS[256] = {
+    [' '] = CHAR_DELIM, ['\f'] = CHAR_DELIM, ['\r'] = CHAR_DELIM,
+    ['\t'] = CHAR_DELIM, ['\v'] = CHAR_DELIM, [','] = CHAR_DELIM,
+    ['('] = CHAR_DELIM, [')'] = CHAR_DELIM,
+    ['\n'] = CHAR_NEWLINE,
+    ['#'] = CHAR_COMMENT
+};
+
+/* Reads the rest of INPUT into a heap buffer, for inputs that cannot be
+   mapped (pipes, terminals). */
+static int read_input(Lexer* lexer, FILE* input) {
+    size_t cap = READ_CHUNK, len = 0;
+    char* buffer = (char *) malloc(cap);
+    if (!buffer) {
+        allocation_failed();
+    }
+    size_t n;
+    while ((n = fread(buffer + len, 1, cap - len, input)) > 0) {
+        len += n;
+        if (len == cap) {
+            cap *= 2;
+            buffer = (char *) realloc(buffer, cap);
+            if (!buffer) {
+                allocation_failed();
+            }
+        }
+    }
+    if (ferror(input)) {
+        free(buffer);
+        return -1;
+    }
+    lexer->buffer = buffer;
+    lexer->data = buffer;
+    lexer->size = len;
+    return 0;
+}
+
+int open_lexer(Lexer* lexer, FILE* input) {
+    struct stat st;
+    long offset = ftell(input);
+
+    lexer->data = NULL;
+    lexer->size = 0;
+    lexer->pos = 0;
+    lexer->line = 0;
+    lexer->map = NULL;
+    lexer->map_size = 0;
+    lexer->buffer = NULL;
+
+    if (offset >= 0 && fstat(fileno(input), &st) == 0 && S_ISREG(st.st_mode)) {
+        if (st.st_size <= offset) {
+            lexer->data = "";
+            return 0;
+        }
+        void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(input), 0);
+        if (map != MAP_FAILED) {
+            madvise(map, st.st_size, MADV_SEQUENTIAL);
+            lexer->map = map;
+            lexer->map_size = st.st_size;
+            lexer->data = (const char *) map + offset;
+            lexer->size = st.st_size - offset;
+            return 0;
+        }
+    }
+    return read_input(lexer, input);
+}
+
+void close_lexer(Lexer* lexer) {
+    if (lexer->map) {
+        munmap(lexer->map, lexer->map_size);
+    }
+    free(lexer->buffer);
+    lexer->map = NULL;
+    lexer->buffer = NULL;
+    lexer->data = NULL;
+    lexer->size = 0;
+}
+
+void open_lexer_text(Lexer* lexer, const char* data, size_t size,
+    uint32_t lines_before) {
+    lexer->data = data;
+    lexer->size = size;
+    lexer->pos = 0;
+    lexer->line = lines_before;
+    lexer->map = NULL;
+    lexer->map_size = 0;
+    lexer->buffer = NULL;
+}
+
+void slice_lexer(Lexer* slice, const Lexer* lexer, size_t begin, size_t end,
+    uint32_t lines_before) {
+    open_lexer_text(slice, lexer->data + begin, end - begin, lines_before);
+}
+
+/* Files the LEN characters at PTR as the next token of LINE: a label if it is
+   the FIRST token and ends in ':', then the name, then the arguments. */
+static void add_token(SourceLine* line, const char* ptr, uint32_t len, int first) {
+    if (first && ptr[len - 1] == ':') {
+        line->has_label = 1;
+        line->label.ptr = ptr;
+        line->label.len = len - 1;
+    } else if (line->name.len == 0) {
+        line->name.ptr = ptr;
+        line->name.len = len;
+    } else if (line->num_args < INST_MAX_ARGS) {
+        line->args[line->num_args].ptr = ptr;
+        line->args[line->num_args].len = len;
+        line->num_args++;
+    } else if (!line->extra.ptr) {
+        line->extra.ptr = ptr;
+        line->extra.len = len;
+    }
+}
+
+/* Scans the next line of the input that holds a label or an instruction into
+   LINE, skipping blank and comment-only lines (which are still counted in
+   LINE->line). Everything from a '#' to the end of the line is a comment.
+
+   Returns 1 if a line was scanned and 0 at the end of the input.
+ */
+int next_line(Lexer* lexer, SourceLine* line) {
+    const char* end = lexer->data + lexer->size;
+    const char* p = lexer->data + lexer->pos;
+
+    while (p < end) {
+        memset(line, 0, sizeof(*line));
+        line->line = ++lexer->line;
+
+        int first = 1;
+        for (;;) {
+            while (p < end && CHAR_CLASS[(unsigned char) *p] == CHAR_DELIM) {
+                p++;
+            }
+            if (p == end || CHAR_CLASS[(unsigned char) *p] != CHAR_TOKEN) {
+                break;
+            }
+            const char* start = p;
+            while (p < end && CHAR_CLASS[(unsigned char) *p] == CHAR_TOKEN) {
+                p++;
+            }
+            add_token(line, start, p - start, first);
+            first = 0;
+        }
+
+        // Skip the comment, if any, and the newline
+        if (p < end && *p != '\n') {
+            p = memchr(p, '\n', end - p);
+            if (!p) {
+                p = end;
+            }
+        }
+        if (p < end) {
+            p++;
+        }
+
+        if (line->has_label || line->name.len > 0) {
+            lexer->pos = p - lexer->data;
+            return 1;
+        }
+    }
+    lexer->pos = lexer->size;
+    return 0;
+}
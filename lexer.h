@@ -0,0 +1,58 @@
+#ifndef LEXER_H
+#define LEXER_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "ir.h"
+
+/* Splits assembler input into lines of tokens. The whole input is mapped (or,
+   for pipes, read) into memory once, and every token is a view into it, so
+   nothing is copied or NUL-terminated and lines may be of any length.
+   Comments are dropped and a leading label is recognized in the same scan.
+ */
+
+typedef struct {
+    uint32_t line;                  // input line, starting at 1
+    int has_label;
+    Token label;                    // leading label, without its ':'
+    Token name;                     // instruction name, len 0 if there is none
+    int num_args;
+    Token args[INST_MAX_ARGS];
+    Token extra;                    // first argument past INST_MAX_ARGS, or NULL ptr
+} SourceLine;
+
+typedef struct {
+    const char* data;
+    size_t size;
+    size_t pos;                     // offset of the next line in DATA
+    uint32_t line;                  // number of lines scanned so far
+    void* map;                      // mapping that holds DATA, or NULL
+    size_t map_size;
+    char* buffer;                   // heap copy that holds DATA, or NULL
+} Lexer;
+
+/* Prepares LEXER to scan the rest of INPUT. Returns 0 on success and -1 if
+   INPUT could not be read. */
+int open_lexer(Lexer* lexer, FILE* input);
+
+/* Makes LEXER scan the SIZE bytes at DATA, which must start a line and
+   stay valid while LEXER is used. LINES_BEFORE is the number of lines that
+   precede DATA. Nothing needs to be closed afterwards. */
+void open_lexer_text(Lexer* lexer, const char* data, size_t size,
+    uint32_t lines_before);
+
+/* Makes SLICE scan bytes BEGIN to END of the input of LEXER, which must start
+   a line. LINES_BEFORE is the number of lines that precede BEGIN. SLICE
+   shares the memory of LEXER and must not outlive it. */
+void slice_lexer(Lexer* slice, const Lexer* lexer, size_t begin, size_t end,
+    uint32_t lines_before);
+
+/* See documentation in lexer.c */
+int next_line(Lexer* lexer, SourceLine* line);
+
+/* Releases the memory holding the input. Tokens returned by next_line() are
+   no longer valid afterwards. */
+void close_lexer(Lexer* lexer);
+
+#endif
@@ -1,7 +1,7 @@
 # CS 61C Summer 2015 Project 2-2 
 # file_utils.s
 #
-# Utilities for opening and closing files
+# Utilities for opening, writing and closing files
 
 .data
 cannot_open_files: .asciiz "Error opening files. Exiting program.\n"
@@ -68,7 +68,8 @@ open_files_err:
 #------------------------------------------------------------------------------
 # function close_files()
 #------------------------------------------------------------------------------
-# Given an array of file pointers, closes all files
+# Given an array of file pointers, closes all files, and frees their readers
+# (see readline()) for the next files opened.
 #
 # Arguments:
 #  $a0 = an array of file pointers
@@ -77,15 +78,51 @@ open_files_err:
 # Returns: none
 #------------------------------------------------------------------------------
 close_files:
-	move $t0, $a0			# Begin open_files()
-	sll $a1, $a1, 2
-	li $t1, 0			# $t1 = counter
-cf_begin:	slt $t2, $t1, $a1		# $a1 = loop end condition (in bytes)
+	addiu $sp, $sp, -16			# Begin close_files()
+	sw $s0, 12($sp)
+	sw $s1, 8($sp)
+	sw $s2, 4($sp)
+	sw $ra, 0($sp)
+	move $s0, $a0
+	sll $s1, $a1, 2		# $s1 = loop end condition (in bytes)
+	li $s2, 0			# $s2 = counter
+cf_begin:	slt $t2, $s2, $s1
 	beq $t2, $0, cf_end
-	addu $t3, $t0, $t1
+	addu $t3, $s0, $s2
 	lw $a0, 0($t3)		# load file descriptor
+	jal forget_reader
 	li $v0, 16
 	syscall			# close file
-	addiu $t1, $t1, 4
+	addiu $s2, $s2, 4
 	j cf_begin
-cf_end:	jr $ra				# End close_files()
+cf_end:	lw $s0, 12($sp)
+	lw $s1, 8($sp)
+	lw $s2, 4($sp)
+	lw $ra, 0($sp)
+	addiu $sp, $sp, 16
+	jr $ra				# End close_files()
+
+#------------------------------------------------------------------------------
+# function write_buffer()
+#------------------------------------------------------------------------------
+# Writes a buffer to a file with as few write syscalls as the OS allows.
+#
+# Arguments:
+#  $a0 = file pointer
+#  $a1 = buffer
+#  $a2 = number of bytes to write
+#
+# Returns: 0 on success and -1 if the file could not be written
+#------------------------------------------------------------------------------
+write_buffer:
+	blez $a2, wb_done		# Begin write_buffer()
+	li $v0, 15
+	syscall			# write to file
+	blez $v0, wb_err		# error, or nothing could be written
+	addu $a1, $a1, $v0
+	subu $a2, $a2, $v0
+	j write_buffer
+wb_done:	li $v0, 0
+	jr $ra
+wb_err:	li $v0, -1
+	jr $ra				# End write_buffer()
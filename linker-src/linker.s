@@ -21,27 +21,27 @@
 
 .data
 base_addr:		.word 0x00400000
-hex_buffer:		.space 10
+# Instructions are written 512 at a time (9 bytes each), with room for the
+# NUL-terminator hex_to_str() adds after the last one:
+out_buffer:		.space 4616
 
 .globl main
 .text
 #------------------------------------------------------------------------------
 # function write_machine_code()
 #------------------------------------------------------------------------------
-# Write the contents of the .text section of the input file to the output file.
-# Fill in the blanks labeled YOUR_INSTRUCTIONS_HERE according to the descriptions
-# above. Each blank may require one or more MIPS instructions, but no blank 
-# requires a lot of instructions (the maximum we used for one blank is 6).
-# There are seven such blanks in total.
-#
-# Note: You may need to store additional registers onto the stack. You should
-# change stack poineter appropriately.
+# Write the instructions of an input file, which fill_data() kept in memory,
+# to the output file.
+# The instructions are collected in out_buffer and written whenever it is full
+# and at the end of the file, rather than with one write each. The numbered
+# comments below follow an instruction from memory to out_buffer, relocating
+# it on the way if it is a jump.
 #
 # Arguments:
 #  $a0 = The output file pointer
-#  $a1 = The input file pointer
-#  $a2 = The symbol table, which you can pass into relocate_inst() if needed
-#  $a3 = The relocation table, which you can pass into relocate_inst() if needed
+#  $a1 = The input file's reloc_data, holding its instructions and their
+#        relocation entries (sorted by sort_relocations())
+#  $a2 = The symbol table, which you can pass into relocate_symbol() if needed
 #
 # Returns: 0 on success and -1 on fail. 
 #------------------------------------------------------------------------------
@@ -60,46 +60,23 @@ write_machine_code:
 	sw $ra, 0($sp)
 	# We'll save the arguments since we are making function calls.
 	move $s0, $a0			# $s0 = output file ptr
-	move $s1, $a1			# $s1 = input file ptr
+	lw $s1, 8($a1)			# $s1 = next instruction
 	move $s2, $a2			# $s2 = symbol table
-	move $s3, $a3			# $s3 = relocation table
-	# We find the start of the .text section by reading each line and 
-	# checking to see if we find ".text".
-write_machine_code_find_text:	
-	move $a0, $s1
-	jal readline
-	blt $v0, $0, write_machine_code_error	# Invalid line reached
-	move $a0, $v1
-	la $a1, textLabel
-	jal streq
-	bne $v0, $0, write_machine_code_find_text
-	# Now, we are at the start of the text section (ie. next time we call
-	# readline(), we will read in the first instruction). Fill in the
-	# blanks below with the correct instruction(s).
+	lw $s3, 4($a1)			# $s3 = next relocation entry
+	lw $s4, 0($a1)			# $s4 = size of the text section
 	
 	# 1. Initialize the byte offset to zero. We will need this for any instructions
 	# that require relocation:
 	add $s6, $0, $0
+	add $s7, $0, $0			# $s7 = # bytes in out_buffer
 
 write_machine_code_next_inst:
-	# 2. Call readline() while passing in the correct arguments:
-	add $a0, $s1, $0
-	jal readline
-
-	# Check whether readline() returned an error.
-	blt $v0, $0, write_machine_code_error
-	# Store whether end-of-file was reached into $s4. We will check this later.
-	move $s4, $v0			
-	# We check whether there are any characters besides the NULL terminator below.
-	lbu $t0, 0($v1)
-	beq $t0, $0, write_machine_code_done
+	# 2. Stop once every instruction has been written:
+	beq $s6, $s4, write_machine_code_done
 	
-	# 3. Looks like there is another instruction. Call parse_int() with base=16
-	# to convert the instruction into a number, and store it into a register:
-	addiu $a1, $0, 16
-	add $a0, $v1, $0
-	jal parse_int
-	add $s5, $v0, $0
+	# 3. Load the next instruction into a register:
+	lw $s5, 0($s1)
+	addiu $s1, $s1, 4
 	
 	# 4. Check if the instruction needs relocation. If it does not, branch to
 	# the label write_machine_code_to_file:
@@ -107,41 +84,61 @@ write_machine_code_next_inst:
 	jal inst_needs_relocation
 	beq $v0, $0, write_machine_code_to_file
 	
-	# 5. Here we handle relocation. Call relocate_inst() with the appropriate
-	# arguments, and store the relocated instruction in the appropriate register:
+	# 5. Here we handle relocation. The relocation entries are sorted by
+	# offset, so $s3 moves forward to the entry for this offset, and
+	# relocate_symbol() is called with its name:
+write_machine_code_find_reloc:
+	lw $t0, 0($s3)
+	bgeu $t0, $s6, write_machine_code_relocate
+	addiu $s3, $s3, 8
+	j write_machine_code_find_reloc
+write_machine_code_relocate:
+	bne $t0, $s6, write_machine_code_error	# not in the relocation table
 	add $a0, $s5, $0
-	add $a1, $s6, $0
+	lw $a1, 4($s3)
 	add $a2, $s2, $0
-	add $a3, $s3, $0
-	jal relocate_inst
+	jal relocate_symbol
 	add $s5, $v0, $0
-	addi $s7, $0, -1
-	beq $s5, $s7, write_machine_code_error
+	addi $t0, $0, -1
+	beq $s5, $t0, write_machine_code_error
 	
 
 write_machine_code_to_file:
-	# 6. Write the instruction into a string buffer via hex_to_str():
+	# 6. Write the instruction after those already in out_buffer via hex_to_str():
 	add $a0, $s5, $0
-	la $a1, hex_buffer
+	la $a1, out_buffer
+	addu $a1, $a1, $s7
 	jal hex_to_str 
 	
 	# 7. Increment the byte offset by the appropriate amount:
 	addiu $s6, $s6, 4
 
-	# Here, we use the write to file syscall. WE specify the output file as $a0.
+	# 8 digits + newline = 9 bytes more to write. Write them out once the
+	# buffer is full.
+	addiu $s7, $s7, 9
+	li $t0, 4608
+	bne $s7, $t0, write_machine_code_next_inst
 	move $a0, $s0
-	# Set $a1 = the buffer that we will write.
-	la $a1, hex_buffer
-	# Set $a2 = number of bytes to write. 8 digits + newline = 9 bytes
-	li $a2, 9			
-	li $v0, 15
-	syscall
-	# Finally, we check whether end-of-file was reached. If not, keep going.
-	bne $s4, $0, write_machine_code_next_inst
+	la $a1, out_buffer
+	move $a2, $s7
+	jal write_buffer
+	bne $v0, $0, write_machine_code_fail
+	add $s7, $0, $0
+	j write_machine_code_next_inst
 write_machine_code_done:
+	move $a0, $s0			# write what is left in out_buffer
+	la $a1, out_buffer
+	move $a2, $s7
+	jal write_buffer
+	bne $v0, $0, write_machine_code_fail
 	li $v0, 0
 	j write_machine_code_end
 write_machine_code_error:
+	move $a0, $s0			# keep the instructions before the error
+	la $a1, out_buffer
+	move $a2, $s7
+	jal write_buffer
+write_machine_code_fail:
 	li $v0, -1
 write_machine_code_end:
 	# Don't forget to change this part if you saved more items onto the stack!
@@ -186,7 +183,9 @@ build_tables:
 	jal open_files
 	move $s3, $v0	# $s3 = file descriptors
 	# Alloc space for reloc_data
-	sll $a0, $s1, 3	# 8 * (# files)
+	sll $t0, $s1, 2
+	sll $a0, $s1, 3
+	addu $a0, $a0, $t0	# 12 * (# files)
 	li $v0, 9
 	syscall
 	move $s4, $v0	# $s4 = array of reloc_data
@@ -201,12 +200,15 @@ build_tables_loop:
 	lw $a0, 0($t5)
 	move $a1, $s6	# $a1 = current symobl table
 	sll $t1, $t0, 1	
+	addu $t1, $t1, $t0	# sizeof(reloc_data) = 12
 	addu $a2, $s4, $t1	# $a2 = current entry in reloc_data
 	move $a3, $s2	# $a3 = current global offset
 	jal fill_data
 	blt $v0, $0, build_tables_error
 	move $s6, $v1	# update symbol table
 	sll $t1, $s5, 3	
+	sll $t0, $s5, 2
+	addu $t1, $t1, $t0
 	addu $t2, $s4, $t1	# current entry in reloc_data
 	lw $t3, 0($t2)
 	addu $s2, $s2, $t3	# update offset
@@ -271,11 +273,8 @@ m_arg_ok:
 	move $s3, $v0		# $s3 = symbol table
 	move $s4, $v1		# $s4 = reloc_data
 	
-	# Open input & output files for writing:
-	move $a0, $s1
-	move $a1, $s0
-	jal open_files
-	move $s1, $v0		# $s1 = array of file ptrs
+	# Open the output file for writing. The input files are not read again,
+	# since fill_data() kept their instructions:
 	move $a0, $s2
 	li $a1, 1
 	li $v0, 13
@@ -285,24 +284,23 @@ m_arg_ok:
 
 	# Begin writing:
 	li $s5, 0
+	la $t0, base_addr
+	lw $s6, 0($t0)		# $s6 = address of the current file's .text
 m_write_loop:
 	beq $s5, $s0, m_write_done
+	la $t0, textBase
+	sw $s6, 0($t0)		# for relocate_symbol()
 	move $a0, $s2		# $a0 = output file
-	sll $t0, $s5, 2		# sizeof(file_ptr) = 4
-	addu $t1, $s1, $t0
-	lw $a1, 0($t1)		# $a1 = input file
+	move $a1, $s4		# $a1 = the file's reloc_data
 	move $a2, $s3		# $a2 = symbol table
-	sll $t0, $s5, 3		# sizeof(reloc_data) = 8
-	addu $t2, $s4, $t0
-	lw $a3, 4($t2)		# $a3 = reloc table
 	jal write_machine_code
 	blt $v0, $0, m_write_error
+	lw $t3, 0($s4)		# text size of the file just written
+	addu $s6, $s6, $t3
+	addiu $s4, $s4, 12	# sizeof(reloc_data) = 12
 	addiu $s5, $s5, 1
 	j m_write_loop
 m_write_done:
-	move $a0, $s1
-	move $a1, $s0
-	jal close_files
 	move $a0, $s2
 	li $v0, 16
 	syscall
@@ -312,9 +310,6 @@ m_write_done:
 	li $v0, 10
 	syscall			# exit without errors
 m_write_error:
-	move $a0, $s1
-	move $a1, $s0
-	jal close_files
 	move $a0, $s2
 	li $v0, 16
 	syscall
@@ -325,9 +320,6 @@ m_write_error:
 	li $v0, 17
 	syscall			# exit with errors
 m_fopen_error:
-	move $a0, $s1
-	move $a1, $s0
-	jal close_files
 	la $a0, error_fopen
 	li $v0, 4
 	syscall
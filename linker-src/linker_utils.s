@@ -12,8 +12,8 @@
 # the .symbol and .relocation section of each object file). During this pass
 # it also computes the size of each text segment so that the final addresses of
 # each symbol is known. The function fill_data(), located at the bottom of this
-# file, performs this operation on a single file. The linker calls fill_data()
-# on each object file.
+# file, performs this operation on a single file, and keeps the file's
+# instructions in memory. The linker calls fill_data() on each object file.
 #
 # At this step, the symbol table contains the absolute address of every symbol
 # as well as the relative byte offsets of each item that needs relocation (why
@@ -22,6 +22,11 @@
 # need relocation. The inst_needs_relocation() function checks whether an 
 # instruction need relocation. If so, the relocate_inst() function will perform
 # the relocation.
+#
+# An object may also have a .textrel section, listing jumps whose target field
+# already holds the word address of a label in the same file. Its entries are
+# added to the relocation table under the name ".text", and relocating them
+# only adds the address of the file's .text, which main() keeps in textBase.
 #==============================================================================
 
 .include "symbol_list.s"
@@ -31,6 +36,11 @@
 textLabel:      .asciiz ".text"
 symLabel:       .asciiz ".symbol"
 relocLabel: .asciiz ".relocation"
+textrelLabel:   .asciiz ".textrel"
+textBase:       .word 0x00400000
+warn_duplicate: .asciiz "Warning: symbol "
+warn_duplicate_end:
+        .asciiz " is defined by more than one object (maybe a local label).\n"
 
 .text
 
@@ -66,7 +76,8 @@ relocate:
 #
 # You should return error if 1) the addr is not in the relocation table or
 # 2) the symbol name is not in the symbol table. You may assume otherwise the 
-# relocation will happen successfully.
+# relocation will happen successfully. Entries named ".text" come from the
+# .textrel section, and are relocated by adding textBase to the target.
 #
 # Arguments:
 #  $a0 = an instruction that needs relocating
@@ -77,109 +88,336 @@ relocate:
 # Returns: the relocated instruction, or -1 if error
 #------------------------------------------------------------------------------
 relocate_inst:  
-                addiu $sp, $sp, -20
+                addiu $sp, $sp, -12
+                sw $ra, 0($sp)
+                sw $s0, 4($sp)
+                sw $s1, 8($sp)
+
+                move $s0, $a0
+                move $s1, $a2
+
+                move $a0, $a3
+                jal symbol_for_addr #find instruction name
+
+                beq $v0, $0, relocate_inst_err
+                move $a0, $s0
+                move $a1, $v0
+                move $a2, $s1
+                jal relocate_symbol
+                j relocate_inst_end
+relocate_inst_err:
+                subiu $v0, $0, 1
+relocate_inst_end:
+                lw $s1, 8($sp)
+                lw $s0, 4($sp)
+                lw $ra, 0($sp)
+                addiu $sp, $sp, 12
+                jr $ra
+
+#------------------------------------------------------------------------------
+# function relocate_symbol()
+#------------------------------------------------------------------------------
+# Relocates an instruction whose relocation entry has already been found: the
+# jump gets the address of the symbol with the entry's name, or for ".text"
+# has textBase added to its target.
+#
+# Arguments:
+#  $a0 = an instruction that needs relocating
+#  $a1 = the name in the instruction's relocation entry
+#  $a2 = the symbol table
+#
+# Returns: the relocated instruction, or -1 if the name is not in the symbol
+# table
+#------------------------------------------------------------------------------
+relocate_symbol:
+                addiu $sp, $sp, -16
                 sw $ra, 0($sp)
                 sw $s0, 4($sp)
                 sw $s1, 8($sp)
                 sw $s2, 12($sp)
-                sw $s3, 16($sp)
 
                 move $s0, $a0
                 move $s1, $a1
                 move $s2, $a2
-                move $s3, $a3
 
-                move $t2, $s0
-                move $a0, $s3
-                jal symbol_for_addr #find instruction name
+                move $a0, $s1
+                la $a1, textLabel
+                jal streq
+                beq $v0, $0, relocate_local
 
-                beq $v0, $0, err
-                addiu $a1, $v0, 0
+                move $a1, $s1
                 move $a0, $s2 
                 jal addr_for_symbol #get address for instruction
 
                 subiu $t1, $0, 1
                 beq $v0, $t1, err
                 srl $v0, $v0, 2
-                andi $t2, $t2, 0xfc000000
+                andi $t2, $s0, 0xfc000000
                 or $v0, $v0, $t2
                 j epilogue
+relocate_local:                 # target is relative to this file's .text
+                la $t0, textBase
+                lw $t0, 0($t0)
+                srl $t0, $t0, 2
+                addu $v0, $s0, $t0
+                j epilogue
 err:            
                 subiu $v0, $0, 1
                 j epilogue 
 epilogue:       
-                lw $s3, 16($sp)
                 lw $s2, 12($sp)
                 lw $s1, 8($sp)
                 lw $s0, 4($sp)
                 lw $ra, 0($sp)
-                addiu $sp, $sp, 20
+                addiu $sp, $sp, 16
                 jr $ra
 
+#------------------------------------------------------------------------------
+# function sort_relocations()
+#------------------------------------------------------------------------------
+# Turns a relocation SymbolList into an array of (offset, name) pairs sorted by
+# offset, so that write_machine_code() can find each instruction's entry by
+# moving through it with the instructions. The array ends with an entry whose
+# offset is -1. The list holds each section newest first, so its entries are
+# copied back to front, which leaves them sorted unless the object also has a
+# .textrel section. Then they are merge sorted.
+#
+# Arguments:
+#  $a0 = the relocation table, as a SymbolList
+#
+# Returns: the array of relocation entries
+#------------------------------------------------------------------------------
+sort_relocations:
+        addiu $sp, $sp, -20
+        sw $s3, 16($sp)
+        sw $s2, 12($sp)
+        sw $s1, 8($sp)
+        sw $s0, 4($sp)
+        sw $ra, 0($sp)
+
+        move $s0, $a0           # $s0 = list
+        li $s1, 0               # $s1 = number of entries
+        move $t0, $s0
+sort_relocs_count:
+        beq $t0, $0, sort_relocs_alloc
+        addiu $s1, $s1, 1
+        lw $t0, 8($t0)
+        j sort_relocs_count
+sort_relocs_alloc:
+        addiu $a0, $s1, 1
+        sll $a0, $a0, 3
+        li $v0, 9
+        syscall
+        move $s2, $v0           # $s2 = array
+        sll $t0, $s1, 3
+        addu $t0, $t0, $s2
+        li $t1, -1
+        sw $t1, 0($t0)          # end marker
+        move $t1, $s0
+sort_relocs_fill:
+        beq $t1, $0, sort_relocs_check
+        addiu $t0, $t0, -8
+        lw $t2, 4($t1)
+        sw $t2, 0($t0)
+        lw $t2, 0($t1)
+        sw $t2, 4($t0)
+        lw $t1, 8($t1)
+        j sort_relocs_fill
+sort_relocs_check:              # leave it alone if it is already sorted
+        li $t0, 1
+sort_relocs_check_next:
+        bge $t0, $s1, sort_relocs_done
+        sll $t1, $t0, 3
+        addu $t1, $t1, $s2
+        lw $t2, -8($t1)
+        lw $t3, 0($t1)
+        bgtu $t2, $t3, sort_relocs_merge
+        addiu $t0, $t0, 1
+        j sort_relocs_check_next
+sort_relocs_merge:
+        addiu $a0, $s1, 1
+        sll $a0, $a0, 3
+        li $v0, 9
+        syscall
+        move $s3, $v0           # $s3 = array to merge into
+        sll $t0, $s1, 3
+        addu $t0, $t0, $s3
+        li $t1, -1
+        sw $t1, 0($t0)
+        li $t8, 1               # $t8 = length of the sorted runs
+sort_relocs_pass:
+        bge $t8, $s1, sort_relocs_done
+        li $t9, 0               # $t9 = start of the next two runs
+sort_relocs_pair:
+        bge $t9, $s1, sort_relocs_pass_end
+        addu $t0, $t9, $t8      # $t0 = end of the first run
+        ble $t0, $s1, sort_relocs_mid
+        move $t0, $s1
+sort_relocs_mid:
+        addu $t1, $t0, $t8      # $t1 = end of the second run
+        ble $t1, $s1, sort_relocs_hi
+        move $t1, $s1
+sort_relocs_hi:
+        move $t2, $t9           # $t2 = next of the first run
+        move $t3, $t0           # $t3 = next of the second run
+        move $t4, $t9           # $t4 = next to write
+sort_relocs_step:
+        beq $t4, $t1, sort_relocs_pair_end
+        beq $t2, $t0, sort_relocs_take_second
+        beq $t3, $t1, sort_relocs_take_first
+        sll $t5, $t2, 3
+        addu $t5, $t5, $s2
+        lw $t6, 0($t5)
+        sll $t5, $t3, 3
+        addu $t5, $t5, $s2
+        lw $t7, 0($t5)
+        bgtu $t6, $t7, sort_relocs_take_second
+sort_relocs_take_first:
+        sll $t5, $t2, 3
+        addu $t5, $t5, $s2
+        addiu $t2, $t2, 1
+        j sort_relocs_copy
+sort_relocs_take_second:
+        sll $t5, $t3, 3
+        addu $t5, $t5, $s2
+        addiu $t3, $t3, 1
+sort_relocs_copy:
+        sll $t6, $t4, 3
+        addu $t6, $t6, $s3
+        lw $t7, 0($t5)
+        sw $t7, 0($t6)
+        lw $t7, 4($t5)
+        sw $t7, 4($t6)
+        addiu $t4, $t4, 1
+        j sort_relocs_step
+sort_relocs_pair_end:
+        move $t9, $t1
+        j sort_relocs_pair
+sort_relocs_pass_end:
+        move $t0, $s2           # the merged runs become the ones to merge
+        move $s2, $s3
+        move $s3, $t0
+        sll $t8, $t8, 1
+        j sort_relocs_pass
+sort_relocs_done:
+        move $v0, $s2
+        lw $s3, 16($sp)
+        lw $s2, 12($sp)
+        lw $s1, 8($sp)
+        lw $s0, 4($sp)
+        lw $ra, 0($sp)
+        addiu $sp, $sp, 20
+        jr $ra
+
 ###############################################################################
 #                 DO NOT MODIFY ANYTHING BELOW THIS POINT                       
 ############################################################################### 
 
 #------------------------------------------------------------------------------
-# function calc_text_size() - DO NOT MODIFY THIS FUNCTION
+# function read_text()
 #------------------------------------------------------------------------------
-# Returns number of bytes that the text section takes up. This function assumes
-# that when called, the file pointer is currently at the beginning of the text
-# section. It also assumes that there will be one instruction per line, and 
-# that the .text section ends with a blank line.
+# Reads the instructions of the text section into an array, so that the file
+# does not have to be read again to write them out. This function assumes that
+# when called, the file pointer is currently at the beginning of the text
+# section. It also assumes that there will be one instruction per line, and
+# that the .text section ends with a blank line. The array starts with room for
+# 1024 instructions and moves to one twice the size whenever it is full.
 #
 # Arguments: 
-#  $a0 = file pointer, must be pointing to 
+#  $a0 = file pointer, must be pointing to the start of the text section
 #
-# Returns: size of the text section in bytes
+# Returns:      $v0 = size of the text section in bytes, or -1 if error
+#       $v1 = the instructions
 #------------------------------------------------------------------------------
-calc_text_size:
-        addiu $sp, $sp, -12
-        sw $s0, 8($sp)
-        sw $s1, 4($sp)
+read_text:
+        addiu $sp, $sp, -24
+        sw $s4, 20($sp)
+        sw $s3, 16($sp)
+        sw $s2, 12($sp)
+        sw $s1, 8($sp)
+        sw $s0, 4($sp)
         sw $ra, 0($sp)
 
-        li $s0, 0                       # Initialize counter
+        li $s0, 0                       # Initialize size
         move $s1, $a0           # store file handle into $s1
-calc_text_size_next:
+        li $s3, 4096            # $s3 = size of the array in bytes
+        move $a0, $s3
+        li $v0, 9
+        syscall
+        move $s2, $v0           # $s2 = array of instructions
+read_text_next:
+        bne $s0, $s3, read_text_line
+        sll $a0, $s3, 1         # full: copy into an array twice the size
+        li $v0, 9
+        syscall
+        li $t0, 0
+read_text_copy:
+        addu $t1, $s2, $t0
+        lw $t2, 0($t1)
+        addu $t1, $v0, $t0
+        sw $t2, 0($t1)
+        addiu $t0, $t0, 4
+        bne $t0, $s3, read_text_copy
+        move $s2, $v0
+        sll $s3, $s3, 1
+read_text_line:
         move $a0, $s1           # $a0 = file handle
         jal readline
-        blt $v0, $0, calc_text_size_error
+        blt $v0, $0, read_text_error
         lbu $t0, 0($v1)         # $t0 = first character in buffer
-        beq $t0, $0, calc_text_size_done        # Reached a line without instructions
+        beq $t0, $0, read_text_done     # Reached a line without instructions
+        move $s4, $v0           # store whether EOF was reached into $s4
+        move $a0, $v1
+        li $a1, 16
+        jal parse_int
+        addu $t0, $s2, $s0
+        sw $v0, 0($t0)
         addiu $s0, $s0, 4               # each instruction = 4 bytes
-        bne $v0, $0, calc_text_size_next        # did not reached end of file
-calc_text_size_done:
+        bne $s4, $0, read_text_next     # did not reached end of file
+read_text_done:
         move $v0, $s0
-        j calc_text_size_exit
-calc_text_size_error:
+        move $v1, $s2
+        j read_text_exit
+read_text_error:
         li $v0, -1
-calc_text_size_exit:
-        lw $s0, 8($sp)
-        lw $s1, 4($sp)
+read_text_exit:
+        lw $s4, 20($sp)
+        lw $s3, 16($sp)
+        lw $s2, 12($sp)
+        lw $s1, 8($sp)
+        lw $s0, 4($sp)
         lw $ra, 0($sp)
-        addiu $sp, $sp, 12
+        addiu $sp, $sp, 24
         jr $ra
 
 #------------------------------------------------------------------------------
-# function add_to_symbol_list() - DO NOT MODIFY THIS FUNCTION
+# function add_to_symbol_list()
 #------------------------------------------------------------------------------
 # Adds entries from the .symbol or .relocation section into the SymbolList. Each 
 # line must be of the format "<number>\t<string>\n", and the section ends with
 # a blank line. The file pointer must be at the begining of the section (so the
 # line immediately after .symbol or .relocation). Returns the status code in $v0
 # and the new SymbolList in $v1.
+#
+# If $a3 is not zero, the list is a symbol table: its nodes are hashed by
+# add_to_list(), and a name that is already in it prints a warning, since
+# jumps to it will go to this object. Otherwise the list is only walked (like
+# relocations), so add_to_plain_list() builds it without a hash index.
 # 
 # Arguments:
 #  $a0 = file pointer
 #  $a1 = the SymbolList to add to (may or may not be empty)
 #  $a2 = base address offset
+#  $a3 = whether the list is a symbol table
 #
 # Returns:      $v0 = 0 if no errors, -1 if error
 #       $v1 = the new SymbolList
 #------------------------------------------------------------------------------
 add_to_symbol_list:
-        addiu $sp, $sp, -20
+        addiu $sp, $sp, -32
+        sw $s6, 28($sp)
+        sw $s5, 24($sp)
+        sw $s4, 20($sp)
         sw $s0, 16($sp)
         sw $s1, 12($sp)
         sw $s2, 8($sp)
@@ -189,6 +427,7 @@ add_to_symbol_list:
         move $s0, $a0           # store file handle into $s0
         move $s1, $a1           # store symbol list into $s1
         move $s2, $a2           # store symbol offset into $s2
+        move $s4, $a3           # store whether it is a symbol table into $s4
 atsl_next:
         move $a0, $s0           # $a0 = file handle
         jal readline
@@ -200,11 +439,35 @@ atsl_next:
         
         move $a0, $v1
         jal tokenize
+        move $s5, $v0           # $s5 = symbol offset in the file
+        move $s6, $v1           # $s6 = symbol name
+        beq $s4, $0, atsl_add_plain
+        move $a0, $s1
+        move $a1, $s6
+        jal addr_for_symbol
+        li $t0, -1
+        beq $v0, $t0, atsl_add
+        la $a0, warn_duplicate
+        li $v0, 4
+        syscall
+        move $a0, $s6
+        syscall
+        la $a0, warn_duplicate_end
+        syscall
+atsl_add:
         move $a0, $s1           # $a0 = symbol list             
-        move $a1, $v1           # $a1 = symbol name (string)
-        addu $a2, $s2, $v0      # $a2 = symbol offset (bytes)
+        move $a1, $s6           # $a1 = symbol name (string)
+        addu $a2, $s2, $s5      # $a2 = symbol offset (bytes)
         jal add_to_list
         move $s1, $v0
+        j atsl_added
+atsl_add_plain:
+        move $a0, $s1
+        move $a1, $s6
+        addu $a2, $s2, $s5
+        jal add_to_plain_list
+        move $s1, $v0
+atsl_added:
         beq $s3, $0, atsl_done
         j atsl_next
 atsl_done:
@@ -214,19 +477,24 @@ atsl_done:
 atsl_error:
         li $v0, -1
 atsl_end:
+        lw $s6, 28($sp)
+        lw $s5, 24($sp)
+        lw $s4, 20($sp)
         lw $s0, 16($sp)
         lw $s1, 12($sp)
         lw $s2, 8($sp)
-        sw $s3, 4($sp)
+        lw $s3, 4($sp)
         lw $ra, 0($sp)
-        addiu $sp, $sp, 20
+        addiu $sp, $sp, 32
         jr $ra
 
 #------------------------------------------------------------------------------
-# function fill_data() - DO NOT MODIFY THIS FUNCTION
+# function fill_data()
 #------------------------------------------------------------------------------
-# Builds the symbol/relocation data for a single file. Calls calc_text_size()
-# and add_to_symbol_list().
+# Builds the symbol/relocation data for a single file, and keeps its
+# instructions. Calls read_text() and add_to_symbol_list(). The .textrel
+# section goes into the same list as the .relocation section. Names in .symbol
+# that an earlier object already defined are warned about.
 # 
 # Arguments:
 #  $a0 = file handle
@@ -238,8 +506,12 @@ atsl_end:
 #  struct reloc_data {
 #    int text_size;
 #    SymbolList* list;
+#    int* text;
 #  }
 #
+# Once the whole file has been read, list is replaced by the array that
+# sort_relocations() makes of it.
+#
 # Returns:      $v0 = 0 if no error, -1 if error
 #       $v1 = the new symbol table ($a2 should be updated)
 #------------------------------------------------------------------------------
@@ -279,16 +551,24 @@ fill_data_next:
         jal streq
         beq $v0, $0, fill_data_reloc
         
+        move $a0, $s4           # Test if reached .textrel section
+        la $a1, textrelLabel
+        jal streq
+        beq $v0, $0, fill_data_reloc
+        
         j fill_data_next
 fill_data_text_size:
         move $a0, $s0
-        jal calc_text_size
+        jal read_text
+        blt $v0, $0, fill_data_error
         sw $v0, 0($s2)
+        sw $v1, 8($s2)
         j fill_data_next
 fill_data_symbol:
         move $a0, $s0
         move $a1, $s1
         move $a2, $s3
+        li $a3, 1               # a symbol table: hashed, duplicates warned about
         jal add_to_symbol_list
         bne $v0, $0, fill_data_error
         move $s5, $v1
@@ -297,6 +577,7 @@ fill_data_reloc:
         move $a0, $s0
         lw $a1, 4($s2)
         li $a2, 0
+        li $a3, 0
         jal add_to_symbol_list
         bne $v0, $0, fill_data_error
         sw $v1, 4($s2)
@@ -305,6 +586,9 @@ fill_data_error:
         li $v0, -1
         j fill_data_end
 fill_data_done:
+        lw $a0, 4($s2)          # look relocations up by offset from now on
+        jal sort_relocations
+        sw $v0, 4($s2)
         li $v0, 0
 fill_data_end:  
         move $v1, $s5
@@ -165,61 +165,238 @@ tokenize_fail: # fallthrough (we should never directly jump to here unless input
 	jr $ra				# End tokenize()
 
 #------------------------------------------------------------------------------
-# function readline() - DO NOT MODIFY THIS FUNCTION
+# function readline()
 #------------------------------------------------------------------------------
 # Reads the next line from the file until a newline or end of file is reached.
 # If a newline was reached, the last newline character is discarded. A NUL-
-# terminator is added to the end of the string read. 
+# terminator is added to the end of the string read. Lines may be of any
+# length.
+#
+# The file is read a block at a time into a buffer of its own (see
+# find_reader()), so that lines are served from memory rather than with one
+# syscall per character. Several files may be read at once. A file must be
+# passed to forget_reader() when it is closed, since the OS may give its
+# handle to the next file opened; close_files() does this.
 #
 # The buffer is returned in $v1. It is VOLATILE - the next time readline() is
-# called, the buffer will be overwritten. This should be fine for most linker
-# functions except for the symbol/relocation table (you will have to create a
-# copy of the string then -- see add_to_list() in Part 2). 
+# called on the same file, the buffer may be overwritten. This should be fine
+# for most linker functions except for the symbol/relocation table (you will
+# have to create a copy of the string then -- see add_to_list() in Part 2). 
 #
 # Arguments:	
 #  $a0 = File handle
 #
-# Returns: 	$v0: the # of bytes read, or -1 if error and nothing was read
+# Returns: 	$v0: 1 if the line ended with a newline, 0 if it ended at the end
+#		of the file (it may still hold characters), or -1 if error
 #	$v1: pointer to buffer with chars read
 #------------------------------------------------------------------------------
 readline:	
-	la $t0, buffer			# Begin readline()
-	li $t1, 512
-	la $a1, buffer
-	li $a2, 1
-readline_next:
-	li $v0, 14			# read until a newline is reached
-	syscall			
-	beq $v0, $0, readline_done	# only end-of-file is left, nothing was read
+	addiu $sp, $sp, -20		# Begin readline()
+	sw $s0, 16($sp)
+	sw $s1, 12($sp)
+	sw $s2, 8($sp)
+	sw $s3, 4($sp)
+	sw $ra, 0($sp)
+	move $s0, $a0			# $s0 = file handle
+	jal find_reader
+	move $s1, $v0			# $s1 = reader of the file
+	lw $s2, 12($s1)			# $s2 = offset where the line starts
+	move $s3, $s2			# $s3 = offset being scanned
+	li $t4, 0x0a			# newline char
+readline_scan:
+	lw $t0, 16($s1)
+	beq $s3, $t0, readline_fill	# ran out of buffered characters
+	lw $t1, 4($s1)
+	addu $t2, $t1, $s3
+	lbu $t3, 0($t2)
+	beq $t3, $t4, readline_newline
+	addiu $s3, $s3, 1
+	j readline_scan
+readline_fill:
+	lw $t0, 20($s1)
+	bne $t0, $0, readline_eof	# nothing more to read
+	# Move the start of the line to the start of the buffer:
+	lw $t1, 4($s1)			# $t1 = buffer
+	lw $t0, 16($s1)
+	subu $t0, $t0, $s2		# $t0 = # chars of the line so far
+	addu $t2, $t1, $s2
+	li $t3, 0
+readline_move:
+	beq $t3, $t0, readline_moved
+	addu $t5, $t2, $t3
+	lbu $t6, 0($t5)
+	addu $t5, $t1, $t3
+	sb $t6, 0($t5)
+	addiu $t3, $t3, 1
+	j readline_move
+readline_moved:
+	sw $t0, 16($s1)
+	move $s3, $t0
+	li $s2, 0
+	lw $t3, 8($s1)			# $t3 = capacity
+	bne $t0, $t3, readline_read
+	# The line fills the buffer, so double it:
+	sll $a0, $t3, 1
+	li $v0, 9
+	syscall
+	sll $t3, $t3, 1
+	sw $t3, 8($s1)
+	lw $t1, 4($s1)
+	li $t3, 0
+readline_copy:
+	beq $t3, $t0, readline_copied
+	addu $t5, $t1, $t3
+	lbu $t6, 0($t5)
+	addu $t5, $v0, $t3
+	sb $t6, 0($t5)
+	addiu $t3, $t3, 1
+	j readline_copy
+readline_copied:
+	sw $v0, 4($s1)
+readline_read:
+	move $a0, $s0			# read as much as fits after the line
+	lw $t1, 4($s1)
+	lw $t0, 16($s1)
+	addu $a1, $t1, $t0
+	lw $t3, 8($s1)
+	subu $a2, $t3, $t0
+	li $v0, 14
+	syscall
 	blt $v0, $0, readline_err	# error, nothing was read
-	lbu $t2, 0($a1)
-	li $t3, 0x0a		# newline char
-	beq $t2, $t3, readline_done
-	addiu $a1, $a1, 1
-	subu $t4, $a1, $t0
-	bgt $t4, $t1, readline_err2
-	j readline_next
-readline_done:			# at this point, $v0 contains the # bytes read
-	sb $0, 0($a1)
-	move $v1, $t0
-	jr $ra
+	li $t4, 0x0a			# newline char
+	beq $v0, $0, readline_at_eof
+	lw $t0, 16($s1)
+	addu $t0, $t0, $v0
+	sw $t0, 16($s1)
+	j readline_scan
+readline_at_eof:
+	li $t0, 1
+	sw $t0, 20($s1)
+readline_eof:				# the rest of the buffer is the last line
+	lw $t1, 4($s1)
+	addu $t2, $t1, $s3
+	sb $0, 0($t2)
+	sw $s3, 12($s1)
+	addu $v1, $t1, $s2
+	li $v0, 0
+	j readline_end
+readline_newline:			# $t2 = the newline
+	sb $0, 0($t2)
+	addiu $s3, $s3, 1
+	sw $s3, 12($s1)
+	lw $t1, 4($s1)
+	addu $v1, $t1, $s2
+	li $v0, 1
+	j readline_end
 readline_err:
+	sw $s2, 12($s1)
 	la $a0, readline_err_syscall
 	li $v0, 4
 	syscall
 	li $v0, -1
-	jr $ra
-readline_err2:
-	la $a0, readline_err_bufsize
-	li $v0, 4
-	syscall
-	li $v0, -1
+readline_end:
+	move $a0, $s0
+	lw $s0, 16($sp)
+	lw $s1, 12($sp)
+	lw $s2, 8($sp)
+	lw $s3, 4($sp)
+	lw $ra, 0($sp)
+	addiu $sp, $sp, 20
 	jr $ra				# End readline()
 
+#------------------------------------------------------------------------------
+# function find_reader()
+#------------------------------------------------------------------------------
+# Returns the reader of a file, creating it when the file is first read. The
+# readers form a list starting at readers. If it were declared in C:
+#
+#  struct reader {
+#    int handle;          // -1 if free for the next file
+#    char* buf;
+#    int cap;             // size of buf, grown for long lines
+#    int pos;             // offset of the next line in buf
+#    int end;             // offset after the characters read so far
+#    int eof;             // whether reading has reached the end of the file
+#    struct reader* next;
+#  }
+#
+# Readers and their buffers are allocated with sbrk, which cannot free them, so
+# the reader of a closed file is reused (with its buffer) for the next one.
+#
+# Arguments:
+#  $a0 = File handle
+#
+# Returns: the reader
+#------------------------------------------------------------------------------
+find_reader:
+	la $t0, readers			# Begin find_reader()
+	lw $t0, 0($t0)
+	li $t2, 0			# $t2 = a free reader, if any
+find_reader_next:
+	beq $t0, $0, find_reader_none
+	lw $t1, 0($t0)
+	beq $t1, $a0, find_reader_found
+	li $t3, -1
+	bne $t1, $t3, find_reader_skip
+	move $t2, $t0
+find_reader_skip:
+	lw $t0, 24($t0)
+	j find_reader_next
+find_reader_none:
+	bne $t2, $0, find_reader_reuse
+	move $t3, $a0			# allocate a reader and a buffer
+	li $a0, 28
+	li $v0, 9
+	syscall
+	move $t2, $v0
+	li $a0, 4096			# initial buffer size
+	sw $a0, 8($t2)
+	li $v0, 9
+	syscall
+	sw $v0, 4($t2)
+	la $t0, readers
+	lw $t1, 0($t0)
+	sw $t1, 24($t2)
+	sw $t2, 0($t0)
+	move $a0, $t3
+find_reader_reuse:
+	sw $a0, 0($t2)
+	sw $0, 12($t2)
+	sw $0, 16($t2)
+	sw $0, 20($t2)
+	move $t0, $t2
+find_reader_found:
+	move $v0, $t0
+	jr $ra				# End find_reader()
+
+#------------------------------------------------------------------------------
+# function forget_reader()
+#------------------------------------------------------------------------------
+# Frees the reader of a file that is being closed, if it has one, for use by
+# the next file opened.
+#
+# Arguments:
+#  $a0 = File handle
+#
+# Returns: none
+#------------------------------------------------------------------------------
+forget_reader:
+	la $t0, readers			# Begin forget_reader()
+	lw $t0, 0($t0)
+forget_reader_next:
+	beq $t0, $0, forget_reader_done
+	lw $t1, 0($t0)
+	bne $t1, $a0, forget_reader_skip
+	li $t1, -1
+	sw $t1, 0($t0)
+forget_reader_skip:
+	lw $t0, 24($t0)
+	j forget_reader_next
+forget_reader_done:
+	jr $ra				# End forget_reader()
+
 .data
-buffer:	.space 1024
+readers:	.word 0
 .data
 readline_err_syscall:
 	.asciiz "Error in readline: Could not read from file.\n"
-readline_err_bufsize:
-	.asciiz "Error in readline: Exceeded maximum buffer size.\n"
@@ -106,6 +106,31 @@ copy_of_str:
 	addiu $sp, $sp, 16
 	jr $ra
 
+#------------------------------------------------------------------------------
+# function str_hash()
+#------------------------------------------------------------------------------
+# Hashes a string with djb2 (hash = hash * 33 ^ c, starting from 5381). Equal
+# strings get equal hashes.
+#
+# Arguments:
+#  $a0 = string input
+#
+# Returns: the 32-bit hash of the string
+#------------------------------------------------------------------------------
+str_hash:
+	li $v0, 5381
+	beq $a0, $0, str_hash_exit
+str_hash_loop:
+	lbu $t0, 0($a0)
+	beq $t0, $0, str_hash_exit
+	sll $t1, $v0, 5
+	addu $v0, $v0, $t1 #hash * 33
+	xor $v0, $v0, $t0
+	addiu $a0, $a0, 1
+	j str_hash_loop
+str_hash_exit:
+	jr $ra
+
 ###############################################################################
 #                 DO NOT MODIFY ANYTHING BELOW THIS POINT                       
 ###############################################################################
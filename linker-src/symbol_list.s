@@ -33,13 +33,90 @@
 
 .include "string.s"
 
+#------------------------------------------------------------------------------
+# Hashing
+#------------------------------------------------------------------------------
+# The linker looks up a symbol for every jump it relocates, so add_to_list()
+# also files each node in a hash index, and addr_for_symbol() only compares
+# names with the same hash. A list is still a chain of nodes that starts with
+# (name, addr, next) and can be walked as before. Nodes made by add_to_list()
+# carry two more words:
+#
+#   typedef struct symbollist {
+#       char* name;
+#       int addr;
+#       struct symbollist* next;
+#       int hash;                   // str_hash() of name
+#       struct symbollist* chain;   // older node in the same bucket
+#   } SymbolList;
+#
+#   struct symbolindex {
+#       SymbolList* latest;         // the last node filed in the index
+#       SymbolList* tail;           // list the index was started on
+#       struct symbolindex* next;   // every index made, newest first
+#       SymbolList* buckets[1024];
+#   };
+#
+# An index is found by the list it ends in, never through the nodes, so any
+# list can be passed in. A list that is not the latest one of an index (like
+# the ones in the tests, or an older version of a list) is walked the old way,
+# and adding to it starts a new index. The tail of an index is walked too, so
+# addr_for_symbol() gives the same answer for any list.
+#
+# Lists that are only walked, like relocations, can be built with
+# add_to_plain_list() instead, which makes plain nodes and no index.
+#------------------------------------------------------------------------------
+
+.data
+symbol_indexes: .word 0
+last_index:     .word 0
+
 .text
 
+#------------------------------------------------------------------------------
+# function list_index()
+#------------------------------------------------------------------------------
+# Finds the hash index whose latest node is the first node of a SymbolList.
+# The index used last is tried first.
+#
+# Arguments:
+#  $a0 = pointer to a SymbolList (NULL indicates empty list)
+#
+# Returns: the index of the list, or 0 if it has none
+#------------------------------------------------------------------------------
+list_index:
+        beq $a0, $0, list_index_none
+        la $t0, last_index
+        lw $v0, 0($t0)
+        beq $v0, $0, list_index_search
+        lw $t1, 0($v0)
+        beq $t1, $a0, list_index_found
+list_index_search:
+        la $v0, symbol_indexes
+        lw $v0, 0($v0)
+list_index_loop:
+        beq $v0, $0, list_index_none
+        lw $t1, 0($v0)
+        beq $t1, $a0, list_index_remember
+        lw $v0, 8($v0)
+        j list_index_loop
+list_index_remember:
+        sw $v0, 0($t0)
+list_index_found:
+        jr $ra
+list_index_none:
+        li $v0, 0
+        jr $ra
+
 #------------------------------------------------------------------------------
 # function addr_for_symbol()
 #------------------------------------------------------------------------------
-# Iterates through the SymbolList and searches for an entry with the given name.
-# If an entry is found, return that addr. Otherwise return -1.
+# Searches the SymbolList for an entry with the given name. If an entry is
+# found, return that addr. Otherwise return -1. When a name was added more than
+# once, the entry nearest the front of the list wins.
+#
+# If the list has a hash index, only the nodes in the name's bucket are
+# compared, followed by the tail the index was started on.
 #
 # Arguments:
 #  $a0 = pointer to a SymbolList (NULL indicates empty list)
@@ -48,48 +125,71 @@
 # Returns:  address of symbol if found or -1 if not found
 #------------------------------------------------------------------------------
 addr_for_symbol:
-        addiu $sp, $sp, -12
+        addiu $sp, $sp, -20
+        sw $s3, 16($sp)
+        sw $s2, 12($sp)
         sw $s1, 8($sp)
         sw $s0, 4($sp)
         sw $ra, 0($sp)
         add $s0, $a0, $0
-        add $s1, $a1, $0        #LOOK HERE
-        beq $a0, $0, Failed     #null case
-        
+        add $s1, $a1, $0
+        jal list_index
+        beq $v0, $0, Loop       # no index: walk the whole list
+        add $s2, $v0, $0        # $s2 = index
+        add $a0, $s1, $0
+        jal str_hash
+        add $s3, $v0, $0        # $s3 = hash of the name
+        andi $t0, $s3, 1023
+        sll $t0, $t0, 2
+        addu $t0, $t0, $s2
+        lw $s0, 12($t0)         # newest node in the bucket
+HashLoop:
+        beq $s0, $0, HashMissed
+        lw $t0, 12($s0)
+        bne $t0, $s3, HashNext
+        lw $a0, 0($s0)
+        add $a1, $s1, $0
+        jal streq
+        beq $v0, $0, Found
+HashNext:
+        lw $s0, 16($s0)
+        j HashLoop
+HashMissed:
+        lw $s0, 4($s2)          # the tail is not hashed
+
 Loop:
         beq $s0, $0, Failed
         lw $a0, 0($s0)
-        jal streq
         add $a1, $s1, $0
+        jal streq
         beq $v0, $0, Found
         lw $s0, 8($s0)
         j Loop
         
 Found:  
         lw $v0, 4($s0)
-        lw $s1, 8($sp)
-        lw $s0, 4($sp)
-        lw $ra, 0($sp)
-        addiu $sp, $sp, 12
-        jr $ra
+        j addr_for_symbol_end
 Failed: 
         li $v0, -1
+addr_for_symbol_end:
+        lw $s3, 16($sp)
+        lw $s2, 12($sp)
         lw $s1, 8($sp)
         lw $s0, 4($sp)
         lw $ra, 0($sp)
-        addiu $sp, $sp, 12
+        addiu $sp, $sp, 20
         jr $ra
         
 #------------------------------------------------------------------------------
 # function add_to_list()
 #------------------------------------------------------------------------------
-# Adds a (name, addr) pair to the FRONT of the list. You should call new_node()
-# to create a new node. You do not need to perform error checking on duplicate 
-# addr or name entries in SymbolList, nor do you need to do alignment checking.
+# Adds a (name, addr) pair to the FRONT of the list and files the new node in
+# the list's hash index, starting a new index if the list is not the latest
+# one of an index. Duplicate names are not checked for here, and the new node
+# hides older ones with the same name.
 #
-# As with Project 2-1, you WILL need to create a copy of the string that was
-# passed in. copy_of_str() from Part 1 will be useful. After new entry has been
-# added to the list, return the new list.
+# The name is copied with copy_of_str(). After the new entry has been added to
+# the list, return the new list.
 #
 # Arguments:
 #   $a0 = ptr to list (may be NULL)
@@ -110,7 +210,9 @@ add_to_list:
         add $s3, $a1, $0 # Store the pointer to the name in $s3
         add $s4, $a2, $0 # Store the address of the symbol in $s4
         
-        jal new_node
+        li $a0, 20       # new_node() plus the hashing fields
+        li $v0, 9
+        syscall
         add $s0, $v0, $0 # Store new node object in $s0
         
         add $a0, $s3, $0 # Set the first argument to be the pointer to the name
@@ -121,6 +223,35 @@ add_to_list:
         sw $s4, 4($s0) # Store the address of the symbol to the new node
         sw $s2, 8($s0) # Store next node to be the pointer to list
         
+        add $a0, $s1, $0
+        jal str_hash
+        sw $v0, 12($s0)
+        
+        add $a0, $s2, $0
+        jal list_index
+        add $s1, $v0, $0 # $s1 = index of the old list
+        bne $s1, $0, add_to_list_file
+        li $a0, 4108     # 3 words and 1024 empty buckets
+        li $v0, 9
+        syscall
+        add $s1, $v0, $0
+        sw $s2, 4($s1)   # the old list becomes the tail
+        la $t0, symbol_indexes
+        lw $t1, 0($t0)
+        sw $t1, 8($s1)
+        sw $s1, 0($t0)
+add_to_list_file:
+        sw $s0, 0($s1)
+        la $t0, last_index
+        sw $s1, 0($t0)
+        lw $t0, 12($s0)
+        andi $t0, $t0, 1023
+        sll $t0, $t0, 2
+        addu $t0, $t0, $s1
+        lw $t1, 12($t0)
+        sw $t1, 16($s0)  # chain to the bucket's older nodes
+        sw $s0, 12($t0)
+        
         add $v0, $s0, $0 # Return the new list
         
         lw $s4, 20($sp)
@@ -133,6 +264,41 @@ add_to_list:
 exit:   
         jr $ra
 
+#------------------------------------------------------------------------------
+# function add_to_plain_list()
+#------------------------------------------------------------------------------
+# Same as add_to_list(), but the new node is a plain one from new_node() and is
+# not filed in any index. For lists that are never looked up by name.
+#
+# Arguments:
+#   $a0 = ptr to list (may be NULL)
+#   $a1 = pointer to name of symbol (string)
+#   $a2 = address of symbol (integer)
+#
+# Returns: the new list
+#------------------------------------------------------------------------------
+add_to_plain_list:
+        addiu $sp, $sp, -16
+        sw $s2, 12($sp)
+        sw $s1, 8($sp)
+        sw $s0, 4($sp)
+        sw $ra, 0($sp)
+        add $s1, $a0, $0
+        add $s2, $a2, $0
+        add $a0, $a1, $0
+        jal copy_of_str
+        add $s0, $v0, $0 # $s0 = copy of the name
+        jal new_node
+        sw $s0, 0($v0)
+        sw $s2, 4($v0)
+        sw $s1, 8($v0)
+        lw $s2, 12($sp)
+        lw $s1, 8($sp)
+        lw $s0, 4($sp)
+        lw $ra, 0($sp)
+        addiu $sp, $sp, 16
+        jr $ra
+
 ###############################################################################
 #                 DO NOT MODIFY ANYTHING BELOW THIS POINT                       
 ###############################################################################
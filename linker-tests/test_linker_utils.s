@@ -33,7 +33,8 @@ sym_2:		.word test_label2 0x0aaaaaac sym_3
 sym_tbl:		.word test_label1 0x0ababab0 sym_2
 
 # Relocation Table
-rel_5:		.word test_label5 40 0
+rel_6:		.word textLabel 48 0
+rel_5:		.word test_label5 40 rel_6
 rel_4:		.word test_label8 100 rel_5
 rel_3:		.word test_label2 128 rel_4
 rel_2:		.word test_label1 32 rel_3
@@ -53,6 +54,9 @@ main:
 	print_newline()
 	jal test_relocate_inst
 
+	print_newline()
+	jal test_sort_relocations
+
 	li $v0, 10
 	syscall
 
@@ -126,13 +130,76 @@ test_relocate_inst:
 	jal relocate_inst
 	check_int_equals($v0, -1)
 	
+	# Relative to .text (from .textrel)
+	la $t0, textBase
+	li $t1, 0x00400010
+	sw $t1, 0($t0)
+	la $a0, 0x0c000003
+	li $a1, 48
+	la $a2, sym_tbl
+	la $a3, rel_tbl
+	jal relocate_inst
+	check_uint_equals($v0, 0x0c100007)
+	
 	lw $ra, 0($sp)
 	addiu $sp, $sp, 4
 	jr $ra
 
+#-------------------------------------------
+# Tests sort_relocations() from linker_utils.s
+#-------------------------------------------
+test_sort_relocations:
+	addiu $sp, $sp, -8
+	sw $s0, 4($sp)
+	sw $ra, 0($sp)
+	print_str(test_sort_relocations_name)
+	
+	li $a0, 0			# .relocation, then .textrel
+	la $a1, test_label1
+	li $a2, 8
+	jal add_to_list
+	move $a0, $v0
+	la $a1, test_label2
+	li $a2, 24
+	jal add_to_list
+	move $a0, $v0
+	la $a1, textLabel
+	li $a2, 4
+	jal add_to_list
+	move $a0, $v0
+	la $a1, textLabel
+	li $a2, 16
+	jal add_to_list
+	move $a0, $v0
+	jal sort_relocations
+	move $s0, $v0
+	
+	lw $t1, 0($s0)
+	check_uint_equals($t1, 4)
+	lw $t1, 8($s0)
+	check_uint_equals($t1, 8)
+	lw $t1, 16($s0)
+	check_uint_equals($t1, 16)
+	lw $t1, 24($s0)
+	check_uint_equals($t1, 24)
+	lw $t1, 32($s0)
+	check_int_equals($t1, -1)
+	lw $t1, 12($s0)
+	check_str_equals($t1, test_label1)
+	
+	li $a0, 0			# no relocations at all
+	jal sort_relocations
+	lw $t1, 0($v0)
+	check_int_equals($t1, -1)
+	
+	lw $s0, 4($sp)
+	lw $ra, 0($sp)
+	addiu $sp, $sp, 8
+	jr $ra
 
 .data
 test_header_name:		.asciiz "Running test linker_utils:\n"
 
 test_inst_needs_relocation_name:	.asciiz "Testing inst_needs_relocation():\n"
-test_relocate_inst_name:	.asciiz "Testing relocate_inst():\n"
\ No newline at end of file
+test_relocate_inst_name:	.asciiz "Testing relocate_inst():\n"
+test_sort_relocations_name:	.asciiz "Testing sort_relocations():\n"
\ No newline at end of file
@@ -6,6 +6,7 @@
 #==============================================================================
 
 .include "../linker-src/parsetools.s"
+.include "../linker-src/file_utils.s"
 .include "test_core.s"
 .include "../linker-src/string.s"
 
@@ -24,6 +25,19 @@ num_4:		.asciiz "ABCDEF12"
 token_1:		.asciiz "15\thello"
 expected_name:	.asciiz "hello"
 
+# Files written by test_write_buffer() and read back by test_readline()
+readline_file:	.asciiz "readline_test.txt"
+alternate_file:	.asciiz "readline_alt.txt"
+edge_text:	.asciiz "\ncrossing the edge\n"
+last_text:	.asciiz "\nlast"
+alternate_text:	.asciiz "one\ntwo\n"
+edge_line:	.asciiz "crossing the edge"
+last_line:	.asciiz "last"
+alternate_line1:	.asciiz "one"
+alternate_line2:	.asciiz "two"
+empty_line:	.asciiz ""
+handles:	.word 0 0
+
 .globl main
 .text
 #-------------------------------------------
@@ -40,6 +54,12 @@ main:
 	#print_newline()
 	#jal test_tokenize
 	
+	print_newline()
+	jal test_write_buffer
+	
+	print_newline()
+	jal test_readline
+	
 	li $v0, 10
 	syscall
 	
@@ -131,11 +151,205 @@ test_tokenize:
 	addiu $sp, $sp, 8
 	jr $ra
 
+#-------------------------------------------
+# Tests write_buffer() from file_utils.s by
+# writing the files test_readline() reads
+#-------------------------------------------
+test_write_buffer:
+	addiu $sp, $sp, -16
+	sw $s2, 12($sp)
+	sw $s1, 8($sp)
+	sw $s0, 4($sp)
+	sw $ra, 0($sp)
+	print_str(test_write_buffer_name)
+	
+	# A line that ends 5 bytes before the end of readline()'s 4096-byte
+	# buffer, one that crosses it, one longer than the buffer, and a last
+	# line with no newline:
+	li $a0, 9200
+	li $v0, 9
+	syscall
+	move $s0, $v0			# $s0 = start of the file
+	move $a0, $s0
+	li $a1, 'a'
+	li $a2, 4090
+	jal fill_chars
+	move $a0, $v0
+	la $a1, edge_text
+	jal copy_chars
+	move $a0, $v0
+	li $a1, 'b'
+	li $a2, 5000
+	jal fill_chars
+	move $a0, $v0
+	la $a1, last_text
+	jal copy_chars
+	subu $s1, $v0, $s0		# $s1 = size of the file
+	
+	la $a0, readline_file
+	li $a1, 1
+	li $a2, 0
+	li $v0, 13
+	syscall
+	move $s2, $v0
+	move $a0, $s2
+	move $a1, $s0
+	move $a2, $s1
+	jal write_buffer
+	check_int_equals($v0, 0)
+	move $a0, $s2
+	li $v0, 16
+	syscall
+	
+	la $a0, alternate_file
+	li $a1, 1
+	li $a2, 0
+	li $v0, 13
+	syscall
+	move $s2, $v0
+	move $a0, $s2
+	la $a1, alternate_text
+	li $a2, 8
+	jal write_buffer
+	check_int_equals($v0, 0)
+	move $a0, $s2			# nothing to write
+	la $a1, alternate_text
+	li $a2, 0
+	jal write_buffer
+	check_int_equals($v0, 0)
+	move $a0, $s2
+	li $v0, 16
+	syscall
+	
+	move $a0, $s2			# the file is closed
+	la $a1, alternate_text
+	li $a2, 8
+	jal write_buffer
+	check_int_equals($v0, -1)
+	
+	lw $s2, 12($sp)
+	lw $s1, 8($sp)
+	lw $s0, 4($sp)
+	lw $ra, 0($sp)
+	addiu $sp, $sp, 16
+	jr $ra
+
+#-------------------------------------------
+# Tests readline() from parsetools.s on two
+# files read in turns
+#-------------------------------------------
+test_readline:
+	addiu $sp, $sp, -16
+	sw $s2, 12($sp)
+	sw $s1, 8($sp)
+	sw $s0, 4($sp)
+	sw $ra, 0($sp)
+	print_str(test_readline_name)
+	
+	la $a0, readline_file
+	li $a1, 0
+	li $a2, 0
+	li $v0, 13
+	syscall
+	move $s0, $v0			# $s0 = the file test_write_buffer() wrote
+	la $a0, alternate_file
+	li $a1, 0
+	li $a2, 0
+	li $v0, 13
+	syscall
+	move $s1, $v0			# $s1 = the file with two short lines
+	
+	move $a0, $s0
+	jal readline
+	move $s2, $v1
+	check_int_equals($v0, 1)
+	move $a0, $s2
+	jal strlen
+	check_int_equals($v0, 4090)
+	
+	move $a0, $s1
+	jal readline
+	move $s2, $v1
+	check_int_equals($v0, 1)
+	check_str_equals($s2, alternate_line1)
+	
+	move $a0, $s0			# crosses the end of the buffer
+	jal readline
+	move $s2, $v1
+	check_int_equals($v0, 1)
+	check_str_equals($s2, edge_line)
+	
+	move $a0, $s1
+	jal readline
+	move $s2, $v1
+	check_int_equals($v0, 1)
+	check_str_equals($s2, alternate_line2)
+	
+	move $a0, $s0			# longer than the buffer
+	jal readline
+	move $s2, $v1
+	check_int_equals($v0, 1)
+	move $a0, $s2
+	jal strlen
+	check_int_equals($v0, 5000)
+	lbu $t1, 4999($s2)
+	check_int_equals($t1, 'b')
+	
+	move $a0, $s1			# nothing after the last newline
+	jal readline
+	move $s2, $v1
+	check_int_equals($v0, 0)
+	check_str_equals($s2, empty_line)
+	
+	move $a0, $s0			# no newline at the end
+	jal readline
+	move $s2, $v1
+	check_int_equals($v0, 0)
+	check_str_equals($s2, last_line)
+	
+	la $a0, handles
+	sw $s0, 0($a0)
+	sw $s1, 4($a0)
+	li $a1, 2
+	jal close_files
+	
+	lw $s2, 12($sp)
+	lw $s1, 8($sp)
+	lw $s0, 4($sp)
+	lw $ra, 0($sp)
+	addiu $sp, $sp, 16
+	jr $ra
+
+# Stores $a2 copies of the character $a1 at $a0. Returns the address after them.
+fill_chars:
+	beq $a2, $0, fill_chars_done
+	sb $a1, 0($a0)
+	addiu $a0, $a0, 1
+	addiu $a2, $a2, -1
+	j fill_chars
+fill_chars_done:
+	move $v0, $a0
+	jr $ra
+
+# Copies the string $a1, without its NUL, to $a0. Returns the address after it.
+copy_chars:
+	lbu $t0, 0($a1)
+	beq $t0, $0, copy_chars_done
+	sb $t0, 0($a0)
+	addiu $a0, $a0, 1
+	addiu $a1, $a1, 1
+	j copy_chars
+copy_chars_done:
+	move $v0, $a0
+	jr $ra
+
 .data
 test_header_name:	.asciiz "Running test parsetools:\n"
 
 test_parse_int_name:	.asciiz "Testing parse_int():\n"
 test_hex_to_str_name:	.asciiz "Testing hex_to_str():\n"
 test_tokenize_name:	.asciiz "Testing tokenize():\n"
+test_write_buffer_name:	.asciiz "Testing write_buffer():\n"
+test_readline_name:	.asciiz "Testing readline():\n"
 
 test_buffer:	.space 10
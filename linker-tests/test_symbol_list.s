@@ -52,6 +52,9 @@ main:
 	print_newline()
 	jal test_add_to_list
 	
+	print_newline()
+	jal test_hashed_lookup
+	
 	li $v0, 10
 	syscall
 
@@ -128,6 +131,113 @@ test_add_to_list:
 	addiu $sp, $sp, 8
 	jr $ra
 	
+#-------------------------------------------
+# Tests addr_for_symbol() on lists made by
+# add_to_list(), which are hashed
+#-------------------------------------------
+test_hashed_lookup:
+	addiu $sp, $sp, -12
+	sw $s1, 8($sp)
+	sw $s0, 4($sp)
+	sw $ra, 0($sp)
+	
+	print_str(test_hashed_lookup_name)
+	li $a0, 0
+	la $a1, test_label1
+	li $a2, 1234
+	jal add_to_list
+	move $a0, $v0
+	la $a1, test_label2
+	li $a2, 3456
+	jal add_to_list
+	move $s0, $v0			# $s0 = list with labels 1 and 2
+	move $a0, $s0
+	la $a1, test_label1
+	li $a2, 5678
+	jal add_to_list
+	move $s1, $v0			# $s1 = label 1 added again
+	
+	move $a0, $s1
+	la $a1, test_label1
+	jal addr_for_symbol
+	check_uint_equals($v0, 5678)
+	move $a0, $s1
+	la $a1, test_label2
+	jal addr_for_symbol
+	check_uint_equals($v0, 3456)
+	move $a0, $s0			# the older list does not see the new node
+	la $a1, test_label1
+	jal addr_for_symbol
+	check_uint_equals($v0, 1234)
+	move $a0, $s1
+	la $a1, test_label3
+	jal addr_for_symbol
+	check_int_equals($v0, -1)
+	
+	move $a0, $s0			# adding to the older list again
+	la $a1, test_label3
+	li $a2, 42
+	jal add_to_list
+	move $s0, $v0
+	move $a0, $s0
+	la $a1, test_label3
+	jal addr_for_symbol
+	check_uint_equals($v0, 42)
+	move $a0, $s0
+	la $a1, test_label1
+	jal addr_for_symbol
+	check_uint_equals($v0, 1234)
+	move $a0, $s1
+	la $a1, test_label3
+	jal addr_for_symbol
+	check_int_equals($v0, -1)
+
+	li $a0, 0			# plain nodes, then a hashed one
+	la $a1, test_label1
+	li $a2, 111
+	jal add_to_plain_list
+	move $a0, $v0
+	la $a1, test_label2
+	li $a2, 222
+	jal add_to_plain_list
+	move $a0, $v0
+	la $a1, test_label3
+	li $a2, 333
+	jal add_to_list
+	move $s0, $v0
+	move $a0, $s0
+	la $a1, test_label1
+	jal addr_for_symbol
+	check_uint_equals($v0, 111)
+	move $a0, $s0
+	la $a1, test_label3
+	jal addr_for_symbol
+	check_uint_equals($v0, 333)
+	lw $a0, 8($s0)
+	li $a1, 222
+	jal symbol_for_addr
+	check_str_equals($v0, test_label2)
+
+	la $a0, node3			# a hashed node on a static list
+	la $a1, test_label1
+	li $a2, 9
+	jal add_to_list
+	move $s0, $v0
+	move $a0, $s0
+	la $a1, test_label1
+	jal addr_for_symbol
+	check_uint_equals($v0, 9)
+	move $a0, $s0
+	la $a1, test_label2
+	jal addr_for_symbol
+	check_uint_equals($v0, 3456)
+
+	lw $s1, 8($sp)
+	lw $s0, 4($sp)
+	lw $ra, 0($sp)
+	addiu $sp, $sp, 12
+	jr $ra
+	
 # $a0 = address of beginning of list
 test_print_list:
 	addiu $sp, $sp, -8
@@ -181,6 +291,7 @@ test_header_name:	.asciiz "Running symbol list tests:\n"
 test_addr_for_symbol_name:.asciiz "Testing addr_for_symbol():\n"
 test_symbol_for_addr_name:.asciiz "Testing symbol_for_addr():\n"
 test_add_to_list_name:	.asciiz "Testing add_to_list():\n"
+test_hashed_lookup_name:.asciiz "Testing addr_for_symbol() on hashed lists:\n"
 
 expected_symbol:	.asciiz "Label 2"
 expected_print_list:	.asciiz "expected:\n5678\tLabel 3\n3456\tLabel 2\n1234\tLabel 1\n"
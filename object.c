@@ -0,0 +1,242 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tables.h"
+#include "translate_utils.h"
+#include "writer.h"
+#include "object.h"
+
+#define MIN_CAPACITY 64
+#define WORDS_PER_WRITE 1024
+
+/* Binary object layout. Every multi-byte field is stored in the byte order
+   given by the header's endian byte.
+
+     header      magic "MOBJ", version, endian (0 little, 1 big), 2 reserved
+                 bytes, then the text word count, symbol count, relocation
+                 count and string table size in bytes
+     .text       one 32-bit word per instruction
+     .symbol     one record per symbol: 32-bit address, 32-bit offset of
+                 the name in the string table
+     .relocation records in the same format as .symbol
+     strings     NUL-terminated names
+ */
+#define BINARY_VERSION 1
+#define HEADER_SIZE 24
+#define RECORD_SIZE 8
+
+Object* create_object(SymbolTable* symtbl, SymbolTable* reltbl, uint32_t capacity) {
+    Object* object = (Object *) malloc(sizeof(Object));
+    if (!object) {
+        allocation_failed();
+    }
+    if (capacity < MIN_CAPACITY) {
+        capacity = MIN_CAPACITY;
+    }
+    object->text = (uint32_t *) malloc(capacity * sizeof(uint32_t));
+    if (!object->text) {
+        allocation_failed();
+    }
+    object->len = 0;
+    object->cap = capacity;
+    object->symtbl = symtbl;
+    object->reltbl = reltbl;
+    object->textrel = NULL;
+    object->textrel_len = 0;
+    return object;
+}
+
+void free_object(Object* object) {
+    free(object->text);
+    free(object->textrel);
+    free(object);
+}
+
+void append_word(Object* object, uint32_t word) {
+    if (object->len == object->cap) {
+        object->cap *= 2;
+        object->text = (uint32_t *) realloc(object->text, object->cap * sizeof(uint32_t));
+        if (!object->text) {
+            allocation_failed();
+        }
+    }
+    object->text[object->len++] = word;
+}
+
+void reserve_words(Object* object, uint32_t count) {
+    if (object->cap - object->len >= count) {
+        return;
+    }
+    while (object->cap - object->len < count) {
+        object->cap *= 2;
+    }
+    object->text = (uint32_t *) realloc(object->text, object->cap * sizeof(uint32_t));
+    if (!object->text) {
+        allocation_failed();
+    }
+}
+
+/* Encodes the target of every jump of OBJECT to a label of its own symbol
+   table as the word address of the label within .text, so that the linker
+   only has to add the address it places .text at. The relocations of those
+   jumps are taken out of OBJECT->reltbl, which is left with the symbols that
+   are not defined here, and their offsets are listed in OBJECT->textrel
+   instead. A text object writes them as the .textrel section:
+
+       .textrel
+       <offset>\t.text
+
+   Binary objects have no such section, so this is only for text objects.
+   A relocation is only resolved if the word at its offset is a jump that
+   still has no target. When pass two leaves out words that fail to encode,
+   later offsets no longer match the words, so callers should not resolve
+   jumps of an object that had errors; this check keeps other words intact.
+   Returns the number of jumps resolved.
+ */
+uint32_t resolve_local_jumps(Object* object) {
+    SymbolTable* reltbl = object->reltbl;
+    uint8_t* keep = (uint8_t *) malloc(reltbl->len + 1);
+    object->textrel = (uint32_t *) realloc(object->textrel,
+        (object->textrel_len + reltbl->len + 1) * sizeof(uint32_t));
+    if (!keep || !object->textrel) {
+        allocation_failed();
+    }
+    int shared = reltbl->names == object->symtbl->names;
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < reltbl->len; i++) {
+        uint32_t index = reltbl->tbl[i].addr / 4;
+        int64_t addr = shared ? get_addr_for_id(object->symtbl, reltbl->tbl[i].id)
+            : get_addr_for_symbol(object->symtbl, symbol_name(reltbl, i));
+        keep[i] = addr < 0 || index >= object->len
+            || (object->text[index] != 0x08000000 && object->text[index] != 0x0c000000);
+        if (keep[i]) {
+            continue;
+        }
+        object->text[index] = (object->text[index] & 0xfc000000)
+            | (((uint32_t) addr >> 2) & 0x03ffffff);
+        object->textrel[object->textrel_len++] = reltbl->tbl[i].addr;
+        count++;
+    }
+    keep_symbols(reltbl, keep);
+    free(keep);
+    return count;
+}
+
+ObjectEmitter object_emitter(int format) {
+    return format == OBJ_FORMAT_BINARY ? write_object_binary : write_object_text;
+}
+
+/* Writes TABLE in the format of write_table(). */
+static void write_symbols(Writer* writer, const SymbolTable* table) {
+    for (uint32_t i = 0; i < table->len; i++) {
+        write_long(writer, table->tbl[i].addr);
+        write_char(writer, '\t');
+        write_string(writer, symbol_name(table, i));
+        write_char(writer, '\n');
+    }
+}
+
+/* Writes the .symbol and .relocation sections of a text object, which
+   follow its .text section, and its .textrel section if it has one. Output
+   that streams .text out as it is encoded writes ".text\n" and the words
+   itself, then calls this. */
+void write_object_tables(Writer* writer, const Object* object) {
+    write_string(writer, "\n.symbol\n");
+    write_symbols(writer, object->symtbl);
+
+    write_string(writer, "\n.relocation\n");
+    write_symbols(writer, object->reltbl);
+
+    if (object->textrel_len > 0) {
+        write_string(writer, "\n.textrel\n");
+        for (uint32_t i = 0; i < object->textrel_len; i++) {
+            write_long(writer, object->textrel[i]);
+            write_string(writer, "\t.text\n");
+        }
+    }
+}
+
+/* Writes the .text, .symbol and .relocation sections as text. The byte order
+   is irrelevant for this format. */
+int write_object_text(FILE* output, const Object* object, int big_endian) {
+    Writer writer;
+    open_writer(&writer, output);
+
+    write_string(&writer, ".text\n");
+    write_hex_words(&writer, object->text, object->len);
+    write_object_tables(&writer, object);
+
+    if (close_writer(&writer) != 0 || fflush(output) != 0) {
+        return -1;
+    }
+    return ferror(output) ? -1 : 0;
+}
+
+static void put_u32(unsigned char* buf, uint32_t value, int big_endian) {
+    if (big_endian) {
+        buf[0] = value >> 24;
+        buf[1] = value >> 16;
+        buf[2] = value >> 8;
+        buf[3] = value;
+    } else {
+        buf[0] = value;
+        buf[1] = value >> 8;
+        buf[2] = value >> 16;
+        buf[3] = value >> 24;
+    }
+}
+
+/* Writes one record per entry of TABLE. STRTAB_OFFSET is the offset in the
+   string table of the first name; returns the offset after the last one. */
+static uint32_t write_records(FILE* output, const SymbolTable* table,
+    uint32_t strtab_offset, int big_endian) {
+    unsigned char record[RECORD_SIZE];
+    for (uint32_t i = 0; i < table->len; i++) {
+        put_u32(record, table->tbl[i].addr, big_endian);
+        put_u32(record + 4, strtab_offset, big_endian);
+        fwrite(record, 1, RECORD_SIZE, output);
+        strtab_offset += strlen(symbol_name(table, i)) + 1;
+    }
+    return strtab_offset;
+}
+
+static void write_names(FILE* output, const SymbolTable* table) {
+    for (uint32_t i = 0; i < table->len; i++) {
+        const char* name = symbol_name(table, i);
+        fwrite(name, 1, strlen(name) + 1, output);
+    }
+}
+
+static uint32_t names_size(const SymbolTable* table) {
+    uint32_t size = 0;
+    for (uint32_t i = 0; i < table->len; i++) {
+        size += strlen(symbol_name(table, i)) + 1;
+    }
+    return size;
+}
+
+/* Writes OBJECT in the binary layout described at the top of this file. */
+int write_object_binary(FILE* output, const Object* object, int big_endian) {
+    unsigned char header[HEADER_SIZE] = {'M', 'O', 'B', 'J', BINARY_VERSION, big_endian ? 1 : 0, 0, 0};
+    put_u32(header + 8, object->len, big_endian);
+    put_u32(header + 12, object->symtbl->len, big_endian);
+    put_u32(header + 16, object->reltbl->len, big_endian);
+    put_u32(header + 20, names_size(object->symtbl) + names_size(object->reltbl), big_endian);
+    fwrite(header, 1, HEADER_SIZE, output);
+
+    unsigned char words[WORDS_PER_WRITE * 4];
+    for (uint32_t i = 0; i < object->len; i += WORDS_PER_WRITE) {
+        uint32_t n = object->len - i < WORDS_PER_WRITE ? object->len - i : WORDS_PER_WRITE;
+        for (uint32_t j = 0; j < n; j++) {
+            put_u32(words + 4 * j, object->text[i + j], big_endian);
+        }
+        fwrite(words, 4, n, output);
+    }
+
+    uint32_t strtab_offset = write_records(output, object->symtbl, 0, big_endian);
+    write_records(output, object->reltbl, strtab_offset, big_endian);
+    write_names(output, object->symtbl);
+    write_names(output, object->reltbl);
+    return ferror(output) ? -1 : 0;
+}
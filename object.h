@@ -0,0 +1,57 @@
+#ifndef OBJECT_H
+#define OBJECT_H
+
+#include <stdint.h>
+
+#include "writer.h"
+
+/* An assembled object file: the encoded .text words plus the symbol and
+   relocation tables. Pass two fills it in and an emitter serializes it.
+ */
+typedef struct {
+    uint32_t* text;
+    uint32_t len;
+    uint32_t cap;
+    SymbolTable* symtbl;
+    SymbolTable* reltbl;
+    uint32_t* textrel;      // offsets of jumps encoded relative to .text
+    uint32_t textrel_len;
+} Object;
+
+/* Output formats. */
+typedef enum {
+    OBJ_FORMAT_TEXT,        // .text/.symbol/.relocation as lines of text
+    OBJ_FORMAT_BINARY       // the sectioned binary layout described in object.c
+} ObjectFormat;
+
+/* Serializes OBJECT to OUTPUT. BIG_ENDIAN selects the byte order of binary
+   formats. Returns 0 on success and -1 if writing failed. */
+typedef int (*ObjectEmitter)(FILE* output, const Object* object, int big_endian);
+
+/* Creates an Object over SYMTBL and RELTBL with room for CAPACITY words. */
+Object* create_object(SymbolTable* symtbl, SymbolTable* reltbl, uint32_t capacity);
+
+/* Frees the Object and its text (but not its tables). */
+void free_object(Object* object);
+
+/* Appends the instruction word WORD to the text of OBJECT. */
+void append_word(Object* object, uint32_t word);
+
+/* Makes room for COUNT more words after the text of OBJECT, so that they can
+   be filled in place before OBJECT->len is advanced. */
+void reserve_words(Object* object, uint32_t count);
+
+/* See documentation in object.c */
+uint32_t resolve_local_jumps(Object* object);
+
+/* Returns the emitter for FORMAT. */
+ObjectEmitter object_emitter(int format);
+
+int write_object_text(FILE* output, const Object* object, int big_endian);
+
+/* See documentation in object.c */
+void write_object_tables(Writer* writer, const Object* object);
+
+int write_object_binary(FILE* output, const Object* object, int big_endian);
+
+#endif
@@ -0,0 +1,52 @@
+#include <stdio.h>
+#include <pthread.h>
+
+#include "parallel.h"
+
+typedef struct {
+    TaskFunc func;
+    void* ctx;
+    uint32_t num_tasks;
+    uint32_t next;          // next task to claim
+} TaskQueue;
+
+/* Claims and runs tasks from QUEUE until there are none left. */
+static void run_queue(TaskQueue* queue) {
+    uint32_t task;
+    while ((task = __atomic_fetch_add(&queue->next, 1, __ATOMIC_RELAXED)) < queue->num_tasks) {
+        queue->func(queue->ctx, task);
+    }
+}
+
+static void* worker(void* arg) {
+    run_queue((TaskQueue *) arg);
+    return NULL;
+}
+
+/* Runs FUNC(CTX, i) for every i from 0 to NUM_TASKS - 1 on up to NUM_THREADS
+   threads (at most MAX_THREADS), including the calling thread. Threads claim
+   tasks in increasing order, and run_tasks() returns once every task has
+   finished. If threads cannot be started, the remaining threads (at least the
+   caller) run all of the tasks.
+ */
+void run_tasks(int num_threads, uint32_t num_tasks, TaskFunc func, void* ctx) {
+    TaskQueue queue = {func, ctx, num_tasks, 0};
+    pthread_t threads[MAX_THREADS];
+    int started = 0;
+
+    if (num_threads > MAX_THREADS) {
+        num_threads = MAX_THREADS;
+    }
+    if ((uint32_t) num_threads > num_tasks) {
+        num_threads = num_tasks;
+    }
+    for (int i = 1; i < num_threads; i++) {
+        if (pthread_create(&threads[started], NULL, worker, &queue) == 0) {
+            started++;
+        }
+    }
+    run_queue(&queue);
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+}
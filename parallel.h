@@ -0,0 +1,14 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stdint.h>
+
+#define MAX_THREADS 64
+
+/* Runs task number TASK of a job. CTX is shared by every task of the job. */
+typedef void (*TaskFunc)(void* ctx, uint32_t task);
+
+/* See documentation in parallel.c */
+void run_tasks(int num_threads, uint32_t num_tasks, TaskFunc func, void* ctx);
+
+#endif
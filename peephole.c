@@ -0,0 +1,282 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tables.h"
+#include "translate.h"
+#include "peephole.h"
+
+#define REG_ZERO 0
+#define REG_AT 1
+
+/* What is known about $at before an instruction. The assembler owns $at, so
+   only the instructions it expanded pseudoinstructions into are expected to
+   read it, and always after setting it in the same expansion. */
+typedef enum {
+    AT_UNKNOWN,
+    AT_CONST,       // $at holds VALUE
+    AT_COPY         // $at holds the same value as register VALUE
+} AtState;
+
+typedef struct {
+    int state;
+    uint32_t value;
+} AtValue;
+
+/* Returns 1 if INST has the operands its descriptor asks for, so that it can
+   be looked at (and encoded) as the machine instruction it names. Anything
+   else is left for pass two to report. */
+static int is_well_formed(const Inst* inst) {
+    if (inst->op == INST_UNKNOWN) {
+        return 0;
+    }
+    const InstDesc* desc = inst_desc(inst->op);
+    if (inst->num_args != desc->num_args) {
+        return 0;
+    }
+    for (int k = 0; k < inst->num_args; k++) {
+        int kind = inst->args[k].kind;
+        long int value = inst->args[k].value;
+        switch (desc->fields[k]) {
+            case FIELD_RS:
+            case FIELD_RT:
+            case FIELD_RD:
+                if (kind != OPND_REG || value < 0 || value > 31) {
+                    return 0;
+                }
+                break;
+            case FIELD_SHAMT:
+                if (kind != OPND_IMM || value < 0 || value > 31) {
+                    return 0;
+                }
+                break;
+            case FIELD_SIMM:
+                if (kind != OPND_IMM || value < -32768 || value > 32767) {
+                    return 0;
+                }
+                break;
+            case FIELD_UIMM:
+                if (kind != OPND_IMM || value < 0 || value > 65535) {
+                    return 0;
+                }
+                break;
+        }
+    }
+    return 1;
+}
+
+static int is_reg(const Operand* operand, long int reg) {
+    return operand->kind == OPND_REG && operand->value == reg;
+}
+
+/* Returns 1 if INST is one of addu, add and or with $zero as an operand.
+   *DST and *SRC are set to the register written and the one copied. */
+static int is_copy(const Inst* inst, long int* dst, long int* src) {
+    if (inst->op != INST_ADDU && inst->op != INST_ADD && inst->op != INST_OR) {
+        return 0;
+    }
+    *dst = inst->args[0].value;
+    if (is_reg(&inst->args[2], REG_ZERO)) {
+        *src = inst->args[1].value;
+        return 1;
+    }
+    if (is_reg(&inst->args[1], REG_ZERO)) {
+        *src = inst->args[2].value;
+        return 1;
+    }
+    return 0;
+}
+
+/* Returns 1 if INST leaves every register as it was: a copy of a register
+   onto itself, or adding, or-ing or shifting it by 0. Writes to $zero (like
+   the canonical nop) are kept, since they are there on purpose. */
+static int is_self_move(const Inst* inst, const AtValue* at) {
+    long int dst, src;
+    if (is_copy(inst, &dst, &src)) {
+        return dst != REG_ZERO && (dst == src
+            || (src == REG_AT && at->state == AT_COPY && at->value == dst));
+    }
+    if (inst->op == INST_ADDIU || inst->op == INST_ORI || inst->op == INST_SLL) {
+        return inst->args[0].value != REG_ZERO
+            && inst->args[0].value == inst->args[1].value && inst->args[2].value == 0;
+    }
+    return 0;
+}
+
+/* Returns the register INST writes, or -1 if it writes none. */
+static long int written_reg(const Inst* inst) {
+    const InstDesc* desc = inst_desc(inst->op);
+    if (desc->format == FMT_R) {
+        return desc->fields[0] == FIELD_RD ? inst->args[0].value : -1;
+    }
+    if (desc->format == FMT_I) {
+        return inst->op == INST_SB || inst->op == INST_SW ? -1 : inst->args[0].value;
+    }
+    return -1;
+}
+
+/* Updates AT after the well-formed INST, which is not a branch or jump. */
+static void update_at(AtValue* at, const Inst* inst) {
+    long int dst = written_reg(inst), src;
+    if (dst != REG_AT) {
+        if (dst >= 0 && at->state == AT_COPY && at->value == dst) {
+            at->state = AT_UNKNOWN;
+        }
+        return;
+    }
+    uint32_t imm = (uint32_t) inst->args[inst->num_args - 1].value;
+    if (inst->op == INST_LUI) {
+        at->state = AT_CONST;
+        at->value = imm << 16;
+    } else if (inst->op == INST_ORI && is_reg(&inst->args[1], REG_ZERO)) {
+        at->state = AT_CONST;
+        at->value = imm;
+    } else if (inst->op == INST_ORI && is_reg(&inst->args[1], REG_AT) && at->state == AT_CONST) {
+        at->value |= imm;
+    } else if (inst->op == INST_ADDIU && is_reg(&inst->args[1], REG_ZERO)) {
+        at->state = AT_CONST;
+        at->value = imm;
+    } else if (is_copy(inst, &dst, &src) && src != REG_AT) {
+        at->state = src == REG_ZERO ? AT_CONST : AT_COPY;
+        at->value = src == REG_ZERO ? 0 : src;
+    } else {
+        at->state = AT_UNKNOWN;
+    }
+}
+
+static void set_op(Inst* inst, int op) {
+    inst->op = op;
+    inst->name = inst_desc(op)->name;
+    inst->name_len = inst_desc(op)->len;
+}
+
+/* Shortens the expansion of li starting at INSTS[i] if it can be done in
+   one instruction, which happens when li was given a constant that fits 16
+   bits unsigned (lui $at 0) or whose lower half is zero (ori rd $at 0).
+   Returns the index of the instruction to remove, or -1.
+ */
+static int64_t shorten_li(Inst* insts, uint32_t i) {
+    Inst* lui = &insts[i];
+    Inst* ori = &insts[i + 1];
+    if (lui->op != INST_LUI || ori->op != INST_ORI || lui->line != ori->line
+        || !is_reg(&lui->args[0], REG_AT) || !is_reg(&ori->args[1], REG_AT)
+        || !is_well_formed(lui) || !is_well_formed(ori)) {
+        return -1;
+    }
+    if (lui->args[1].value == 0) {
+        ori->args[1].value = REG_ZERO;
+        return i;
+    }
+    if (ori->args[2].value == 0) {
+        lui->args[0] = ori->args[0];
+        return i + 1;
+    }
+    return -1;
+}
+
+/* Rewrites the instructions of INSTS, which pass one produced with the
+   labels in SYMTBL, into a shorter or cheaper equivalent. Pseudoinstructions
+   are expanded one at a time, so the expansions repeat work and use add,
+   which traps on overflow, where nothing can overflow. This pass
+
+   - turns li of a constant that needs only one instruction into that one,
+   - removes a lui $at of the value that $at already holds, as when several
+     li in a row load constants with the same upper half,
+   - removes copies of a register onto itself (like move $t0 $t0, or the
+     last step of swpr $t0 $t0) and other instructions that change nothing,
+   - and uses addu instead of add when one operand is $zero.
+
+   It relies on $at being the assembler's: its value after an instruction
+   expanded from a pseudoinstruction may differ from the unoptimized code.
+   What $at holds is forgotten at every label and after every branch or
+   jump, so that code reached from elsewhere is never assumed to have run
+   what precedes it. Instructions that pass two will reject are left alone.
+
+   Removing instructions moves the labels after them, so the addresses in
+   SYMTBL are moved to match. Branches and jumps name their labels and need
+   no change. Returns the number of instructions removed.
+ */
+uint32_t optimize_insts(InstList* insts, SymbolTable* symtbl) {
+    uint32_t n = insts->len;
+    if (n == 0) {
+        return 0;
+    }
+    uint8_t* labeled = (uint8_t *) calloc(n + 1, 1);
+    uint8_t* removed = (uint8_t *) calloc(n, 1);
+    uint32_t* shift = (uint32_t *) malloc((n + 1) * sizeof(uint32_t));
+    if (!labeled || !removed || !shift) {
+        allocation_failed();
+    }
+    for (uint32_t k = 0; k < symtbl->len; k++) {
+        uint32_t index = symtbl->tbl[k].addr / 4;
+        labeled[index < n ? index : n] = 1;
+    }
+
+    AtValue at = {AT_UNKNOWN, 0};
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        Inst* inst = &insts->insts[i];
+        if (labeled[i]) {
+            at.state = AT_UNKNOWN;
+        }
+        if (removed[i]) {
+            continue;
+        }
+        if (!is_well_formed(inst)) {
+            at.state = AT_UNKNOWN;
+            continue;
+        }
+        int format = inst_desc(inst->op)->format;
+        if (format == FMT_BRANCH || format == FMT_JUMP || inst->op == INST_JR) {
+            at.state = AT_UNKNOWN;
+            continue;
+        }
+
+        if (i + 1 < n && !labeled[i + 1]) {
+            int64_t index = shorten_li(insts->insts, i);
+            if (index >= 0) {
+                removed[index] = 1;
+                count++;
+                if (removed[i]) {
+                    continue;
+                }
+            }
+        }
+        if ((inst->op == INST_LUI && is_reg(&inst->args[0], REG_AT) && at.state == AT_CONST
+            && at.value == (uint32_t) inst->args[1].value << 16) || is_self_move(inst, &at)) {
+            removed[i] = 1;
+            count++;
+            continue;
+        }
+        long int dst, src;
+        if (inst->op == INST_ADD && is_copy(inst, &dst, &src)) {
+            set_op(inst, INST_ADDU);
+        }
+        update_at(&at, inst);
+    }
+
+    if (count > 0) {
+        // SHIFT[i] is the number of removed instructions before instruction i
+        uint32_t len = 0;
+        for (uint32_t i = 0; i < n; i++) {
+            shift[i] = i - len;
+            if (!removed[i]) {
+                insts->insts[len++] = insts->insts[i];
+            }
+        }
+        shift[n] = n - len;
+        insts->len = len;
+
+        for (uint32_t k = 0; k < symtbl->len; k++) {
+            uint32_t index = symtbl->tbl[k].addr / 4;
+            if (index <= n) {
+                symtbl->tbl[k].addr = 4 * (index - shift[index]);
+            }
+        }
+    }
+
+    free(labeled);
+    free(removed);
+    free(shift);
+    return count;
+}
@@ -0,0 +1,11 @@
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include <stdint.h>
+
+#include "ir.h"
+
+/* See documentation in peephole.c */
+uint32_t optimize_insts(InstList* insts, SymbolTable* symtbl);
+
+#endif
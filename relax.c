@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tables.h"
+#include "translate.h"
+#include "relax.h"
+
+/* A program of at most this many instructions has every address within
+   reach of a branch from every other, so there is nothing to relax. */
+#define MAX_UNRELAXED_INSTS 32768
+
+/* Returns 1 if INST is a branch that relax_branches() could rewrite: beq or
+   bne between two registers to a label. */
+static int is_relaxable(const Inst* inst) {
+    return (inst->op == INST_BEQ || inst->op == INST_BNE) && inst->num_args == 3
+        && inst->args[0].kind == OPND_REG && inst->args[1].kind == OPND_REG
+        && inst->args[2].kind == OPND_LABEL;
+}
+
+/* Rewrites every branch of INSTS whose label is out of reach into the
+   inverted branch over a jump to the label:
+
+       beq $rs, $rt, far          bne $rs, $rt, 1      # skips the j
+                           ->     j far
+
+   The jump is relocated like any other, so pass two adds its entry to the
+   relocation table. Each rewrite moves every later label, which can put
+   further branches out of reach, so the branches to rewrite are found again
+   until no more are: since rewriting only ever moves labels further apart,
+   this reaches a fixed point. The addresses in SYMTBL, which must hold the
+   labels of INSTS as pass one found them, are then moved to match. Branches
+   in reach keep their single word, and branches to labels that are not in
+   SYMTBL are left for pass two to report.
+
+   Returns the number of branches rewritten.
+ */
+uint32_t relax_branches(InstList* insts, SymbolTable* symtbl) {
+    uint32_t n = insts->len;
+    if (n <= MAX_UNRELAXED_INSTS) {
+        return 0;
+    }
+
+    // Index of the instruction each relaxable branch targets
+    int64_t* target = (int64_t *) malloc(n * sizeof(int64_t));
+    uint8_t* relaxed = (uint8_t *) calloc(n, 1);
+    uint32_t* shift = (uint32_t *) malloc((n + 1) * sizeof(uint32_t));
+    if (!target || !relaxed || !shift) {
+        allocation_failed();
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        const Inst* inst = &insts->insts[i];
+        target[i] = -1;
+        if (is_relaxable(inst)) {
+            int64_t addr = get_addr_for_symbol_n(symtbl, inst->args[2].text, inst->args[2].len);
+            target[i] = addr < 0 ? -1 : addr / 4;
+        }
+    }
+
+    // SHIFT[i] is the number of rewritten branches before instruction i
+    uint32_t count = 0;
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        uint32_t before = 0;
+        for (uint32_t i = 0; i < n; i++) {
+            shift[i] = before;
+            before += relaxed[i];
+        }
+        shift[n] = before;
+        for (uint32_t i = 0; i < n; i++) {
+            if (target[i] < 0 || relaxed[i]) {
+                continue;
+            }
+            uint32_t addr = 4 * (i + shift[i]);
+            uint32_t label_addr = 4 * (target[i] + shift[target[i]]);
+            if (!can_branch_to(addr, label_addr)) {
+                relaxed[i] = 1;
+                count++;
+                changed = 1;
+            }
+        }
+    }
+
+    if (count > 0) {
+        Inst* out = (Inst *) malloc((n + count) * sizeof(Inst));
+        if (!out) {
+            allocation_failed();
+        }
+        uint32_t len = 0;
+        for (uint32_t i = 0; i < n; i++) {
+            const Inst* inst = &insts->insts[i];
+            if (!relaxed[i]) {
+                out[len++] = *inst;
+                continue;
+            }
+            Inst* branch = &out[len++];
+            *branch = *inst;
+            branch->op = inst->op == INST_BEQ ? INST_BNE : INST_BEQ;
+            branch->name = inst_desc(branch->op)->name;
+            branch->name_len = inst_desc(branch->op)->len;
+            branch->args[2].kind = OPND_OFFSET;
+            branch->args[2].value = 1;
+
+            Inst* jump = &out[len++];
+            memset(jump, 0, sizeof(*jump));
+            jump->op = INST_J;
+            jump->name = inst_desc(INST_J)->name;
+            jump->name_len = inst_desc(INST_J)->len;
+            jump->line = inst->line;
+            jump->num_args = 1;
+            jump->args[0] = inst->args[2];
+        }
+        free(insts->insts);
+        insts->insts = out;
+        insts->len = len;
+        insts->cap = len;
+
+        for (uint32_t k = 0; k < symtbl->len; k++) {
+            uint32_t index = symtbl->tbl[k].addr / 4;
+            symtbl->tbl[k].addr = 4 * (index + shift[index]);
+        }
+    }
+
+    free(target);
+    free(relaxed);
+    free(shift);
+    return count;
+}
@@ -0,0 +1,11 @@
+#ifndef RELAX_H
+#define RELAX_H
+
+#include <stdint.h>
+
+#include "ir.h"
+
+/* See documentation in relax.c */
+uint32_t relax_branches(InstList* insts, SymbolTable* symtbl);
+
+#endif
@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <time.h>
+
+#include "tables.h"
+#include "translate.h"
+#include "lexer.h"
+#include "stats.h"
+
+double stats_clock() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Fills in the line and per-mnemonic counters of STATS from a second scan of
+   INPUT, which INSTS was assembled from. Every instruction of INSTS records
+   the input line it came from, so walking both in order matches each source
+   line with the instructions it expanded to without pass one having to count
+   anything itself.
+
+   Returns 0 on success and -1 if INPUT could not be read again.
+ */
+int count_source_stats(AssemblerStats* stats, FILE* input, const InstList* insts) {
+    Lexer lexer;
+    SourceLine line;
+    uint32_t next = 0;
+
+    rewind(input);
+    if (open_lexer(&lexer, input) != 0) {
+        return -1;
+    }
+    while (next_line(&lexer, &line)) {
+        if (line.name.len == 0) {
+            continue;
+        }
+        // The descriptor table is indexed by InstOp
+        const InstDesc* desc = find_inst(line.name.ptr, line.name.len);
+        int op = desc ? (int) (desc - inst_desc(INST_UNKNOWN)) : INST_UNKNOWN;
+        uint32_t first = next;
+        while (next < insts->len && insts->insts[next].line == line.line) {
+            next++;
+        }
+        stats->op_lines[op]++;
+        stats->op_insts[op] += next - first;
+    }
+    stats->lines = lexer.line;
+    stats->insts = insts->len;
+    close_lexer(&lexer);
+    return 0;
+}
+
+/* Writes STR as a JSON string. */
+static void write_json_string(FILE* output, const char* str) {
+    putc('"', output);
+    for (; *str; str++) {
+        unsigned char c = (unsigned char) *str;
+        if (c == '"' || c == '\\') {
+            fprintf(output, "\\%c", c);
+        } else if (c < 0x20) {
+            fprintf(output, "\\u%04x", c);
+        } else {
+            putc(c, output);
+        }
+    }
+    putc('"', output);
+}
+
+/* Writes STATS for the input file IN_NAME to OUTPUT as one JSON object,
+   without a trailing newline. Mnemonics that never appeared are left out of
+   "ops"; unknown mnemonics are counted under "unknown".
+ */
+void write_stats_json(FILE* output, const char* in_name, const AssemblerStats* stats) {
+    fprintf(output, "{\"file\": ");
+    write_json_string(output, in_name ? in_name : "");
+    fprintf(output, ", \"pass_one_sec\": %.6f, \"pass_two_sec\": %.6f, "
+        "\"write_sec\": %.6f, \"total_sec\": %.6f", stats->pass_one_sec,
+        stats->pass_two_sec, stats->write_sec, stats->total_sec);
+    fprintf(output, ", \"lines\": %u, \"insts\": %u, \"symbols\": %u, "
+        "\"relocations\": %u, \"symbol_probes\": %llu, \"bytes_written\": %llu, "
+        "\"relaxed_branches\": %u, \"optimized_insts\": %u, \"local_jumps\": %u, "
+        "\"cache_hit\": %s", stats->lines, stats->insts, stats->symbols, stats->relocations,
+        (unsigned long long) stats->symbol_probes, (unsigned long long) stats->bytes_written,
+        stats->relaxed_branches, stats->optimized_insts, stats->local_jumps,
+        stats->cache_hit ? "true" : "false");
+
+    fprintf(output, ", \"ops\": {");
+    int first = 1;
+    for (int op = 0; op < NUM_INST_OPS; op++) {
+        if (stats->op_lines[op] == 0) {
+            continue;
+        }
+        fprintf(output, "%s\"%s\": {\"lines\": %u, \"insts\": %u}", first ? "" : ", ",
+            op == INST_UNKNOWN ? "unknown" : inst_desc(op)->name,
+            stats->op_lines[op], stats->op_insts[op]);
+        first = 0;
+    }
+    fprintf(output, "}}");
+}
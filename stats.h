@@ -0,0 +1,42 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "ir.h"
+
+/* Timings and counters of one run of assemble(). Nothing is collected unless
+   the caller asks for it through AssemblerOptions, and most counters are
+   gathered after the passes have run rather than inside them. On a cache
+   hit neither pass runs, so only the time, size and hit are filled in.
+ */
+typedef struct {
+    double pass_one_sec;
+    double pass_two_sec;
+    double write_sec;               // serializing the object and its tables
+    double total_sec;
+    uint32_t lines;                 // input lines read, blank ones included
+    uint32_t insts;                 // machine instructions emitted
+    uint32_t op_lines[NUM_INST_OPS];    // source lines per mnemonic
+    uint32_t op_insts[NUM_INST_OPS];    // instructions emitted for those lines
+    uint32_t symbols;
+    uint32_t relocations;
+    uint32_t relaxed_branches;      // branches rewritten to reach their label
+    uint32_t optimized_insts;       // instructions removed by optimize_insts()
+    uint32_t local_jumps;           // jumps moved from .relocation to .textrel
+    uint64_t symbol_probes;         // symbol table index slots examined
+    uint64_t bytes_written;         // size of the object file
+    int cache_hit;                  // the object was copied from the cache
+} AssemblerStats;
+
+/* Returns a monotonic time in seconds. */
+double stats_clock();
+
+/* See documentation in stats.c */
+int count_source_stats(AssemblerStats* stats, FILE* input, const InstList* insts);
+
+/* See documentation in stats.c */
+void write_stats_json(FILE* output, const char* in_name, const AssemblerStats* stats);
+
+#endif
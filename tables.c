@@ -11,14 +11,14 @@ const int SYMTBL_UNIQUE_NAME = 1;
 
 #define INITIAL_SIZE 5
 #define SCALING_FACTOR 2
+#define INITIAL_INDEX_SIZE 16     // name IDs FIRST covers at first
 
 /*******************************
  * Helper Functions
  *******************************/
 
 void allocation_failed() {
-    write_to_log("Error: allocation failed\n");
-    exit(1);
+    fatal_error("Error: allocation failed\n");
 }
 
 void addr_alignment_incorrect() {
@@ -29,6 +29,10 @@ void name_already_exists(const char* name) {
     write_to_log("Error: name '%s' already exists in table.\n", name);
 }
 
+static void name_n_already_exists(const char* name, size_t len) {
+    write_to_log("Error: name '%.*s' already exists in table.\n", (int) len, name);
+}
+
 void write_symbol(FILE* output, uint32_t addr, const char* name) {
     fprintf(output, "%u\t%s\n", addr, name);
 }
@@ -44,40 +48,84 @@ void write_symbol(FILE* output, uint32_t addr, const char* name) {
    to store this value for use during add_to_table().
  */
 SymbolTable* create_table(int mode) {
-    SymbolTable *table = (SymbolTable *) malloc(INITIAL_SIZE * sizeof(SymbolTable));
+    return create_table_with_capacity(mode, INITIAL_SIZE);
+}
+
+/* Creates a table for about CAPACITY symbols whose names are interned in
+   NAMES, taking over the caller's reference to it. */
+static SymbolTable* create_table_with_names(int mode, uint32_t capacity, Interner* names) {
+    SymbolTable *table = (SymbolTable *) malloc(sizeof(SymbolTable));
 
     if (table == NULL) {
       allocation_failed();
     }
 
+    if (capacity < INITIAL_SIZE) {
+      capacity = INITIAL_SIZE;
+    }
+
     /** Allocate memory for the array containing symbols. **/
-    table->tbl = (Symbol *) malloc(0);
+    table->tbl = (Symbol *) malloc(capacity * sizeof(Symbol));
     if (table->tbl == NULL) {
       allocation_failed();
     }
 
     table->len = 0;
-    table->cap = INITIAL_SIZE;
+    table->cap = capacity;
     table->mode = mode;
+    table->first = NULL;
+    table->first_cap = 0;
+    table->names = names;
+    table->probes = NULL;
 
     return table;
 }
 
+/* Same as create_table(), but sizes the table up front for about CAPACITY
+   symbols so that callers who know roughly how many labels to expect avoid
+   regrowing it.
+ */
+SymbolTable* create_table_with_capacity(int mode, uint32_t capacity) {
+    return create_table_with_names(mode, capacity, create_interner(capacity));
+}
+
+/* Same as create_table(), but names are interned together with those of
+   OTHER, so that a name has the same ID in both tables (see
+   get_addr_for_id()). Tables that share names must only be added to from
+   one thread at a time, even if they are different tables.
+ */
+SymbolTable* create_table_sharing(int mode, SymbolTable* other) {
+    return create_table_with_names(mode, INITIAL_SIZE, share_interner(other->names));
+}
+
 /* Frees the given SymbolTable and all associated memory. */
 void free_table(SymbolTable* table) {
+    free_interner(table->names);
+    free(table->first);
     free(table->tbl);
     free(table);
 }
 
-/* A suggested helper function for copying the contents of a string. */
-static char* create_copy_of_str(const char* str) {
-    size_t len = strlen(str) + 1;
-    char *buf = (char *) malloc(len);
-    if (!buf) {
-       allocation_failed();
+const char* symbol_name(const SymbolTable* table, uint32_t i) {
+    return interned_name(table->names, table->tbl[i].id);
+}
+
+/* Makes TABLE->first cover the name ID ID. */
+static void cover_id(SymbolTable* table, uint32_t id) {
+    if (id < table->first_cap) {
+      return;
+    }
+    uint32_t old_cap = table->first_cap;
+    uint32_t new_cap = old_cap ? old_cap : INITIAL_INDEX_SIZE;
+    while (new_cap <= id) {
+      new_cap *= SCALING_FACTOR;
     }
-    strncpy(buf, str, len); 
-    return buf;
+    table->first = (uint32_t *) realloc(table->first, new_cap * sizeof(uint32_t));
+    if (table->first == NULL) {
+      allocation_failed();
+    }
+    memset(table->first + old_cap, 0, (new_cap - old_cap) * sizeof(uint32_t));
+    table->first_cap = new_cap;
 }
 
 /* Adds a new symbol and its address to the SymbolTable pointed to by TABLE. 
@@ -95,70 +143,104 @@ static char* create_copy_of_str(const char* str) {
    Otherwise, you should store the symbol name and address and return 0.
  */
 int add_to_table(SymbolTable* table, const char* name, uint32_t addr) {
+    return add_to_table_n(table, name, strlen(name), addr);
+}
+
+/* Same as add_to_table(), for the LEN characters at NAME (which need not be
+   NUL-terminated). The name is stored once per Interner, however many
+   symbols have it.
+ */
+int add_to_table_n(SymbolTable* table, const char* name, size_t len, uint32_t addr) {
     if ((addr % 4) != 0) {
       addr_alignment_incorrect();
       return -1;
     }
 
-    /** Creates a copy of NAME. **/
-    char *copy_of_str = create_copy_of_str(name);
+    uint32_t id = intern_name(table->names, name, len, table->probes);
+    cover_id(table, id);
 
-    /** Creates a copy of the symbols in TABLE. **/
-    Symbol copy[table->len];
-    int count;
-    for(count = 0; count < table->len; count++) {
-      Symbol current_symbol = table->tbl[count];
+    /** If the table's mode is SYMTBL_UNIQUE_NAME and NAME already exists. **/
+    if (table->first[id] != 0 && table->mode == SYMTBL_UNIQUE_NAME) {
+      name_n_already_exists(name, len);
+      return -1;
+    }
 
-      /** If the table's mode is SYMTBL_UNIQUE_NAME and NAME already exists. **/
-      int equal = strcmp(current_symbol.name, copy_of_str);
-      if (equal == 0 && table->mode == SYMTBL_UNIQUE_NAME) {
-        name_already_exists(copy_of_str);
-        return -1;
+    /** Grow the symbols array geometrically once it is full. **/
+    if (table->len == table->cap) {
+      table->cap = table->cap * SCALING_FACTOR;
+      table->tbl = realloc(table->tbl, (table->cap * sizeof(Symbol)));
+      if (table->tbl == NULL) {
+        allocation_failed();
       }
-
-      copy[count] = current_symbol;
     }
 
-    /** Increase the size of the symbols array by 1 and
-        allocate more memeory to the array. **/
+    /** Add the new symbol to the end of the array and remember it if it is
+        the first symbol with this name. **/
+    Symbol new_symbol = {id, addr};
+    table->tbl[table->len] = new_symbol;
     table->len = table->len + 1;
-    table->tbl = realloc(table->tbl, (table->len * sizeof(Symbol)));
-    if (table->tbl == NULL) {
-      allocation_failed();
+    if (table->first[id] == 0) {
+      table->first[id] = table->len;
     }
 
-    /** Now that we have resized our symbols array, add all 
-        of the symbols back into the resized array. **/
-    int i = 0;
-    while (i < table->len - 1) {
-      table->tbl[i] = copy[i];
-      i++;
-    }
+    return 0;
+}
 
-    /** Add the new symbol to the end of the array. **/
-    Symbol new_symbol = {copy_of_str, addr};
-    table->tbl[table->len - 1] = new_symbol;
+/* Removes from TABLE every symbol at position i for which KEEP[i] is zero,
+   keeping the others in order. Their names stay interned.
+ */
+void keep_symbols(SymbolTable* table, const uint8_t* keep) {
+    uint32_t len = 0;
+    for (uint32_t i = 0; i < table->len; i++) {
+      if (keep[i]) {
+        table->tbl[len++] = table->tbl[i];
+      }
+    }
+    table->len = len;
 
-    return 0;
+    /** Positions have moved, so find the first symbol of each name again. **/
+    if (table->first_cap > 0) {
+      memset(table->first, 0, table->first_cap * sizeof(uint32_t));
+    }
+    for (uint32_t i = 0; i < len; i++) {
+      if (table->first[table->tbl[i].id] == 0) {
+        table->first[table->tbl[i].id] = i + 1;
+      }
+    }
 }
 
 /* Returns the address (byte offset) of the given symbol. If a symbol with name
    NAME is not present in TABLE, return -1.
  */
 int64_t get_addr_for_symbol(SymbolTable* table, const char* name) {
-    int count;
-    for (count = 0; count < table->len; count++) {
-      Symbol current_symbol = table->tbl[count];
-      if (strcmp(current_symbol.name, name) == 0) {
-        return current_symbol.addr;
-      }
+    return get_addr_for_symbol_n(table, name, strlen(name));
+}
+
+/* Same as get_addr_for_symbol(), for the LEN characters at NAME. */
+int64_t get_addr_for_symbol_n(SymbolTable* table, const char* name, size_t len) {
+    int64_t id = find_name(table->names, name, len, table->probes);
+    if (id < 0) {
+      return -1;
     }
-    return -1;
+    return get_addr_for_id(table, id);
+}
+
+/* Same as get_addr_for_symbol(), for the name with ID ID in the Interner of
+   TABLE, as found in any table that shares it. Compares no strings.
+ */
+int64_t get_addr_for_id(const SymbolTable* table, uint32_t id) {
+    if (id >= table->first_cap || table->first[id] == 0) {
+      return -1;
+    }
+    return table->tbl[table->first[id] - 1].addr;
 }
 
 /* Writes the SymbolTable TABLE to OUTPUT. You should use write_symbol() to
    perform the write. Do not print any additional whitespace or characters.
  */
 void write_table(SymbolTable* table, FILE* output) {
-    /* YOUR CODE HERE */
+    uint32_t i;
+    for (i = 0; i < table->len; i++) {
+      write_symbol(output, table->tbl[i].addr, symbol_name(table, i));
+    }
 }
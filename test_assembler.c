@@ -1,5 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
 #include <unistd.h>
 
 #include <CUnit/Basic.h>
@@ -8,6 +10,15 @@
 #include "src/tables.h"
 #include "src/translate_utils.h"
 #include "src/translate.h"
+#include "src/object.h"
+#include "src/lexer.h"
+#include "src/parallel.h"
+#include "src/writer.h"
+#include "src/stats.h"
+#include "src/cache.h"
+#include "src/relax.h"
+#include "src/peephole.h"
+#include "src/assembler.h"
 
 const char* TMP_FILE = "test_output.txt";
 const int BUF_SIZE = 1024;
@@ -28,6 +39,7 @@ int init_log_file() {
 int check_lines_equal(char **arr, int num) {
     char buf[BUF_SIZE];
 
+    flush_log();
     FILE *f = fopen(TMP_FILE, "r");
     if (!f) {
         CU_FAIL("Could not open temporary file");
@@ -44,6 +56,17 @@ int check_lines_equal(char **arr, int num) {
     return 0;
 }
 
+/* Writes TEXT to the file NAME, replacing it. */
+void write_file(const char* name, const char* text) {
+    FILE* f = fopen(name, "w");
+    if (!f) {
+        CU_FAIL("Could not create file");
+        return;
+    }
+    fputs(text, f);
+    fclose(f);
+}
+
 /****************************************
  *  Test cases for translate_utils.c 
  ****************************************/
@@ -62,7 +85,20 @@ void test_translate_reg() {
     CU_ASSERT_EQUAL(translate_reg("$t3"), 11);
     CU_ASSERT_EQUAL(translate_reg("$s0"), 16);
     CU_ASSERT_EQUAL(translate_reg("$s1"), 17);
-    CU_ASSERT_EQUAL(translate_reg("$3"), -1);
+    CU_ASSERT_EQUAL(translate_reg("$3"), 3);
+    CU_ASSERT_EQUAL(translate_reg("$31"), 31);
+    CU_ASSERT_EQUAL(translate_reg("$t9"), 25);
+    CU_ASSERT_EQUAL(translate_reg("$s7"), 23);
+    CU_ASSERT_EQUAL(translate_reg("$k1"), 27);
+    CU_ASSERT_EQUAL(translate_reg("$gp"), 28);
+    CU_ASSERT_EQUAL(translate_reg("$fp"), 30);
+    CU_ASSERT_EQUAL(translate_reg("$ra"), 31);
+    CU_ASSERT_EQUAL(translate_reg("$zero"), 0);
+    CU_ASSERT_EQUAL(translate_reg("$32"), -1);
+    CU_ASSERT_EQUAL(translate_reg("$s8"), -1);
+    CU_ASSERT_EQUAL(translate_reg("$a4"), -1);
+    CU_ASSERT_EQUAL(translate_reg("$"), -1);
+    CU_ASSERT_EQUAL(translate_reg("$zeros"), -1);
     CU_ASSERT_EQUAL(translate_reg("asdf"), -1);
     CU_ASSERT_EQUAL(translate_reg("hey there"), -1);
 }
@@ -83,6 +119,17 @@ void test_translate_num() {
     CU_ASSERT_EQUAL(output, 72);
     CU_ASSERT_EQUAL(translate_num(&output, "72", 73, 150), -1);
     CU_ASSERT_EQUAL(translate_num(&output, "35x", -100, 100), -1);
+
+    /** Only the first LEN characters are parsed. **/
+    CU_ASSERT_EQUAL(translate_num_n(&output, "-0x10,", 5, -100, 100), 0);
+    CU_ASSERT_EQUAL(output, -16);
+    CU_ASSERT_EQUAL(translate_num_n(&output, "017", 3, 0, 100), 0);
+    CU_ASSERT_EQUAL(output, 15);
+    CU_ASSERT_EQUAL(translate_num_n(&output, "0x", 2, 0, 100), -1);
+    CU_ASSERT_EQUAL(translate_num_n(&output, "-", 1, -100, 100), -1);
+    CU_ASSERT_EQUAL(translate_num_n(&output, "99999999999999999999", 20, LONG_MIN, LONG_MAX), -1);
+    CU_ASSERT_EQUAL(translate_num_n(&output, "-9223372036854775808", 20, LONG_MIN, LONG_MAX), 0);
+    CU_ASSERT_EQUAL(output, LONG_MIN);
 }
 
 /****************************************
@@ -123,6 +170,8 @@ void test_table_1() {
     CU_ASSERT_EQUAL(retval, 0);
     retval = add_to_table(tbl2, "q45", 24); 
     CU_ASSERT_EQUAL(retval, 0);
+    retval = get_addr_for_symbol(tbl2, "q45");
+    CU_ASSERT_EQUAL(retval, 16);
 
     free_table(tbl2);
 
@@ -150,6 +199,62 @@ void test_table_2() {
     free_table(tbl);
 }
 
+void test_table_3() {
+    int retval, max = 1000;
+
+    SymbolTable* tbl = create_table_with_capacity(SYMTBL_NON_UNIQUE, 8);
+    CU_ASSERT_PTR_NOT_NULL(tbl);
+    CU_ASSERT_EQUAL(tbl->cap, 8);
+
+    char buf[10];
+    for (int i = 0; i < max; i++) {
+        sprintf(buf, "L%d", i % 500);
+        retval = add_to_table(tbl, buf, 4 * i);
+        CU_ASSERT_EQUAL(retval, 0);
+    }
+    CU_ASSERT_EQUAL(tbl->len, max);
+    CU_ASSERT(tbl->cap >= tbl->len);
+
+    /** Names added twice resolve to their first address. **/
+    retval = get_addr_for_symbol(tbl, "L499");
+    CU_ASSERT_EQUAL(retval, 4 * 499);
+    CU_ASSERT_EQUAL(strcmp(symbol_name(tbl, max - 1), "L499"), 0);
+
+    free_table(tbl);
+}
+
+void test_table_sharing() {
+    SymbolTable* symtbl = create_table(SYMTBL_UNIQUE_NAME);
+    SymbolTable* reltbl = create_table_sharing(SYMTBL_NON_UNIQUE, symtbl);
+
+    add_to_table(symtbl, "main", 0);
+    add_to_table(symtbl, "loop", 8);
+    add_to_table(reltbl, "printf", 4);
+    add_to_table(reltbl, "loop", 12);
+    add_to_table(reltbl, "printf", 16);
+
+    /** Both tables give a name the same ID, and store it once. **/
+    CU_ASSERT_PTR_EQUAL(symtbl->names, reltbl->names);
+    CU_ASSERT_EQUAL(symtbl->names->len, 3);
+    CU_ASSERT_EQUAL(reltbl->tbl[1].id, symtbl->tbl[1].id);
+    CU_ASSERT_EQUAL(reltbl->tbl[0].id, reltbl->tbl[2].id);
+    CU_ASSERT_EQUAL(get_addr_for_id(symtbl, reltbl->tbl[1].id), 8);
+    CU_ASSERT_EQUAL(get_addr_for_id(symtbl, reltbl->tbl[0].id), -1);
+    CU_ASSERT_EQUAL(get_addr_for_id(reltbl, reltbl->tbl[0].id), 4);
+    CU_ASSERT_EQUAL(strcmp(symbol_name(reltbl, 2), "printf"), 0);
+
+    /** A name is only taken in the table it was added to. **/
+    CU_ASSERT_EQUAL(get_addr_for_symbol(symtbl, "printf"), -1);
+    CU_ASSERT_EQUAL(add_to_table(symtbl, "printf", 20), 0);
+    CU_ASSERT_EQUAL(get_addr_for_symbol(symtbl, "printf"), 20);
+    CU_ASSERT_EQUAL(symtbl->names->len, 3);
+
+    /** The names outlive the table that created them. **/
+    free_table(symtbl);
+    CU_ASSERT_EQUAL(strcmp(symbol_name(reltbl, 1), "loop"), 0);
+    free_table(reltbl);
+}
+
 /****************************************
  *  Test cases for translate.c 
  ****************************************/
@@ -168,6 +273,7 @@ void test_write_pass_one() {
         by 32 bits. 
     **/
     char *array[2];
+    array[0] = "$s0";
     array[1] = "4294967296";
     CU_ASSERT_EQUAL(write_pass_one(NULL, "li", array, 2), 0);
 
@@ -211,8 +317,974 @@ void test_write_pass_one() {
 
 }
 
+void test_expand_pass_one() {
+    InstList* insts = create_inst_list(0);
+    char *args[3];
+
+    /** li with a large immediate expands to a decoded lui-ori pair. **/
+    args[0] = "$t0";
+    args[1] = "0x12345678";
+    CU_ASSERT_EQUAL(expand_pass_one(insts, 7, "li", args, 2), 2);
+    CU_ASSERT_EQUAL(insts->len, 2);
+    CU_ASSERT_EQUAL(insts->insts[0].op, INST_LUI);
+    CU_ASSERT_EQUAL(insts->insts[0].args[1].value, 0x1234);
+    CU_ASSERT_EQUAL(insts->insts[1].op, INST_ORI);
+    CU_ASSERT_EQUAL(insts->insts[1].args[0].kind, OPND_REG);
+    CU_ASSERT_EQUAL(insts->insts[1].args[0].value, 8);
+    CU_ASSERT_EQUAL(insts->insts[1].line, 7);
+
+    /** Label operands are copied into the list. **/
+    char label[] = "loop";
+    args[0] = "$t0";
+    args[1] = "$t1";
+    args[2] = label;
+    CU_ASSERT_EQUAL(expand_pass_one(insts, 8, "beq", args, 3), 1);
+    label[0] = 'x';
+    CU_ASSERT_EQUAL(insts->insts[2].args[2].kind, OPND_LABEL);
+    CU_ASSERT_EQUAL(strcmp(insts->insts[2].args[2].text, "loop"), 0);
+
+    /** Errors do not append anything. **/
+    CU_ASSERT_EQUAL(expand_pass_one(insts, 9, "blt", args, 2), 0);
+    CU_ASSERT_EQUAL(insts->len, 3);
+
+    free_inst_list(insts);
+}
+
+void test_find_inst() {
+    /** Every descriptor is reachable through the perfect hash. **/
+    for (int op = INST_UNKNOWN + 1; op < NUM_INST_OPS; op++) {
+        const InstDesc* desc = inst_desc(op);
+        CU_ASSERT_PTR_NOT_NULL(desc->name);
+        CU_ASSERT_EQUAL(desc->len, strlen(desc->name));
+        CU_ASSERT(find_inst(desc->name, desc->len) == desc);
+    }
+    CU_ASSERT_PTR_NULL(find_inst("addx", 4));
+    CU_ASSERT_PTR_NULL(find_inst("ad", 2));
+    CU_ASSERT_PTR_NULL(find_inst("", 0));
+    CU_ASSERT(find_inst("jalr", 3) == inst_desc(INST_JAL));
+}
+
+void test_translate_inst() {
+    InstList* insts = create_inst_list(0);
+    char *args[3];
+    uint32_t word;
+
+    args[0] = "$t0";
+    args[1] = "-4";
+    args[2] = "$sp";
+    CU_ASSERT_EQUAL(expand_pass_one(insts, 1, "lw", args, 3), 1);
+    CU_ASSERT_EQUAL(encode_inst(&word, &insts->insts[0], 0, NULL, NULL), 0);
+    CU_ASSERT_EQUAL(word, 0x8fa8fffc);
+
+    /** Immediates must fit in 16 bits. **/
+    args[1] = "40000";
+    CU_ASSERT_EQUAL(expand_pass_one(insts, 2, "lw", args, 3), 1);
+    CU_ASSERT_EQUAL(encode_inst(&word, &insts->insts[1], 4, NULL, NULL), -1);
+
+    /** rem expands into div and mfhi, both of which encode. **/
+    args[0] = "$s0";
+    args[1] = "$s1";
+    args[2] = "$s2";
+    CU_ASSERT_EQUAL(expand_pass_one(insts, 3, "rem", args, 3), 2);
+    CU_ASSERT_EQUAL(encode_inst(&word, &insts->insts[2], 8, NULL, NULL), 0);
+    CU_ASSERT_EQUAL(word, 0x0232001a);
+    CU_ASSERT_EQUAL(encode_inst(&word, &insts->insts[3], 12, NULL, NULL), 0);
+    CU_ASSERT_EQUAL(word, 0x00008010);
+
+    /** Without a symbol table a branch is encoded with offset 0, to be
+        patched once its label is known. **/
+    args[0] = "$t0";
+    args[1] = "$t1";
+    args[2] = "later";
+    CU_ASSERT_EQUAL(expand_pass_one(insts, 4, "beq", args, 3), 1);
+    CU_ASSERT_EQUAL(encode_inst(&word, &insts->insts[4], 16, NULL, NULL), 0);
+    CU_ASSERT_EQUAL(word, 0x11090000);
+    CU_ASSERT_EQUAL(patch_branch(&word, 16, 8), 0);
+    CU_ASSERT_EQUAL(word, 0x1109fffd);
+    word = 0x11090000;
+    CU_ASSERT_EQUAL(patch_branch(&word, 16, 16 + 131072), 0);
+    CU_ASSERT_EQUAL(word, 0x11097fff);
+    word = 0x11090000;
+    CU_ASSERT_EQUAL(patch_branch(&word, 16, 16 + 131076), -1);
+
+    free_inst_list(insts);
+}
+
+/****************************************
+ *  Test cases for lexer.c 
+ ****************************************/
+
+static int token_equals(Token token, const char* str) {
+    return token.len == strlen(str) && strncmp(token.ptr, str, token.len) == 0;
+}
+
+void test_next_line() {
+    FILE* f = tmpfile();
+    fprintf(f, "main: addiu $t0 $0 5 # comment\n\n  # only a comment\n");
+    fprintf(f, "loop:\r\nsw $t0,-4($sp)\naddu $t0 $t1 $t2 $t3 $t4\n");
+    for (int i = 0; i < 2000; i++) {
+        fputc(' ', f);
+    }
+    fprintf(f, "jr $ra");
+    rewind(f);
+
+    Lexer lexer;
+    SourceLine line;
+    CU_ASSERT_EQUAL(open_lexer(&lexer, f), 0);
+
+    CU_ASSERT_EQUAL(next_line(&lexer, &line), 1);
+    CU_ASSERT_EQUAL(line.line, 1);
+    CU_ASSERT(line.has_label && token_equals(line.label, "main"));
+    CU_ASSERT(token_equals(line.name, "addiu"));
+    CU_ASSERT_EQUAL(line.num_args, 3);
+    CU_ASSERT(token_equals(line.args[2], "5"));
+
+    /** Blank and comment-only lines are skipped but counted. **/
+    CU_ASSERT_EQUAL(next_line(&lexer, &line), 1);
+    CU_ASSERT_EQUAL(line.line, 4);
+    CU_ASSERT(line.has_label && token_equals(line.label, "loop"));
+    CU_ASSERT_EQUAL(line.name.len, 0);
+
+    CU_ASSERT_EQUAL(next_line(&lexer, &line), 1);
+    CU_ASSERT_EQUAL(line.has_label, 0);
+    CU_ASSERT_EQUAL(line.num_args, 3);
+    CU_ASSERT(token_equals(line.args[1], "-4"));
+    CU_ASSERT(token_equals(line.args[2], "$sp"));
+    CU_ASSERT_PTR_NULL(line.extra.ptr);
+
+    CU_ASSERT_EQUAL(next_line(&lexer, &line), 1);
+    CU_ASSERT_EQUAL(line.num_args, 3);
+    CU_ASSERT(token_equals(line.extra, "$t3"));
+
+    /** Lines have no length limit and the last needs no newline. **/
+    CU_ASSERT_EQUAL(next_line(&lexer, &line), 1);
+    CU_ASSERT_EQUAL(line.line, 7);
+    CU_ASSERT(token_equals(line.name, "jr"));
+    CU_ASSERT(token_equals(line.args[0], "$ra"));
+
+    CU_ASSERT_EQUAL(next_line(&lexer, &line), 0);
+    close_lexer(&lexer);
+    fclose(f);
+}
+
+/****************************************
+ *  Test cases for parallel.c 
+ ****************************************/
+
+static void square_task(void* ctx, uint32_t task) {
+    uint32_t* squares = (uint32_t *) ctx;
+    squares[task] += task * task;
+}
+
+void test_run_tasks() {
+    uint32_t squares[1000] = {0};
+
+    /** Every task runs exactly once, whatever the number of threads. **/
+    run_tasks(8, 1000, square_task, squares);
+    run_tasks(1, 1000, square_task, squares);
+    run_tasks(MAX_THREADS + 1, 3, square_task, squares);
+    int ok = 1;
+    for (uint32_t i = 0; i < 1000; i++) {
+        ok &= squares[i] == (i < 3 ? 3 : 2) * i * i;
+    }
+    CU_ASSERT(ok);
+}
+
+/****************************************
+ *  Test cases for utils.c 
+ ****************************************/
+
+static void log_task(void* ctx, uint32_t task) {
+    LogBuffer* logs = (LogBuffer *) ctx;
+    capture_log(&logs[task]);
+    for (uint32_t i = 0; i <= task; i++) {
+        write_to_log("%u", task);
+    }
+    capture_log(NULL);
+}
+
+void test_capture_log() {
+    LogBuffer logs[40] = {{0}};
+
+    /** Each thread captures only what it logs itself. **/
+    run_tasks(4, 40, log_task, logs);
+    CU_ASSERT_EQUAL(logs[0].len, 1);
+    CU_ASSERT_EQUAL(strcmp(logs[3].data, "3333"), 0);
+    CU_ASSERT_EQUAL(logs[39].len, 80);
+
+    /** Captures nest, and captured text can be replayed into another. **/
+    LogBuffer outer = {0}, inner = {0};
+    CU_ASSERT_PTR_NULL(capture_log(&outer));
+    write_to_log("a");
+    CU_ASSERT(capture_log(&inner) == &outer);
+    write_to_log("b");
+    CU_ASSERT(capture_log(&outer) == &inner);
+    write_log_text(&inner, 0, inner.len);
+    CU_ASSERT(capture_log(NULL) == &outer);
+    CU_ASSERT_EQUAL(strcmp(outer.data, "ab"), 0);
+    free_log_buffer(&outer);
+    free_log_buffer(&inner);
+
+    /** Captured text keeps the level of each message. **/
+    LogBuffer levels = {0};
+    capture_log(&levels);
+    log_message(LOG_WARNING, "warn");
+    log_message(LOG_ERROR, "ing\n");
+    write_to_log("error\n");
+    log_message(LOG_INFO, "info\n");
+    capture_log(NULL);
+    CU_ASSERT_EQUAL(levels.num_marks, 3);
+    CU_ASSERT_EQUAL(levels.marks[0].level, LOG_WARNING);
+    CU_ASSERT_EQUAL(levels.marks[1].offset, 8);
+    CU_ASSERT_EQUAL(levels.marks[1].level, LOG_ERROR);
+    CU_ASSERT_EQUAL(levels.marks[2].level, LOG_INFO);
+    free_log_buffer(&levels);
+
+    for (int i = 0; i < 40; i++) {
+        free_log_buffer(&logs[i]);
+    }
+}
+
+void test_error_limit() {
+    set_log_file(TMP_FILE);
+    set_error_limit(2);
+
+    /** Errors past the limit are counted and noted before the next
+        message; messages below the log level are dropped. **/
+    for (int i = 0; i < 5; i++) {
+        write_to_log("Error %d", i);
+        write_to_log("\n");
+    }
+    log_message(LOG_INFO, "done\n");
+    set_log_level(LOG_ERROR);
+    log_message(LOG_WARNING, "hidden\n");
+    set_log_level(LOG_INFO);
+    log_message(LOG_INFO, "shown\n");
+
+    char* arr[] = {"Error 0", "Error 1", "(3 more errors not shown)", "done", "shown"};
+    check_lines_equal(arr, 5);
+    set_error_limit(0);
+}
+
+/****************************************
+ *  Test cases for writer.c 
+ ****************************************/
+
+void test_write_hex_words() {
+    const int count = 20000;
+    uint32_t* words = (uint32_t *) malloc(count * sizeof(uint32_t));
+    for (int i = 0; i < count; i++) {
+        words[i] = (uint32_t) i * 2654435761u;
+    }
+    words[0] = 0;
+    words[1] = 0xffffffff;
+
+    /** The output must match fprintf("%08x\n") byte for byte, across
+        several buffer flushes. **/
+    FILE* f = tmpfile();
+    Writer writer;
+    open_writer(&writer, f);
+    write_hex_words(&writer, words, count);
+    write_long(&writer, -2147483648L);
+    write_char(&writer, ' ');
+    write_long(&writer, 0);
+    CU_ASSERT_EQUAL(close_writer(&writer), 0);
+
+    rewind(f);
+    char line[32], expected[32];
+    int ok = 1;
+    for (int i = 0; i < count; i++) {
+        sprintf(expected, "%08x\n", words[i]);
+        ok &= fgets(line, sizeof(line), f) && strcmp(line, expected) == 0;
+    }
+    CU_ASSERT(ok);
+    CU_ASSERT_PTR_NOT_NULL(fgets(line, sizeof(line), f));
+    CU_ASSERT_EQUAL(strcmp(line, "-2147483648 0"), 0);
+    fclose(f);
+    free(words);
+}
+
+/****************************************
+ *  Test cases for stats.c 
+ ****************************************/
+
+void test_count_source_stats() {
+    const char* source = "foo: li $t0, 0x12345678  # two words\n"
+                         "\n"
+                         "bar:\n"
+                         "addu $t0 $t1 $t2\n"
+                         "bogus $t0\n";
+    char* li_args[] = {"$t0", "0x12345678"};
+    char* addu_args[] = {"$t0", "$t1", "$t2"};
+    char* bogus_args[] = {"$t0"};
+    InstList* insts = create_inst_list(0);
+    AssemblerStats stats;
+
+    /** Each source line is matched with the instructions it expanded to. **/
+    expand_pass_one(insts, 1, "li", li_args, 2);
+    expand_pass_one(insts, 4, "addu", addu_args, 3);
+    expand_pass_one(insts, 5, "bogus", bogus_args, 1);
+    FILE* f = tmpfile();
+    fputs(source, f);
+    memset(&stats, 0, sizeof(stats));
+    CU_ASSERT_EQUAL(count_source_stats(&stats, f, insts), 0);
+    fclose(f);
+
+    CU_ASSERT_EQUAL(stats.lines, 5);
+    CU_ASSERT_EQUAL(stats.insts, 4);
+    CU_ASSERT_EQUAL(stats.op_lines[INST_LI], 1);
+    CU_ASSERT_EQUAL(stats.op_insts[INST_LI], 2);
+    CU_ASSERT_EQUAL(stats.op_lines[INST_ADDU], 1);
+    CU_ASSERT_EQUAL(stats.op_insts[INST_ADDU], 1);
+    CU_ASSERT_EQUAL(stats.op_lines[INST_UNKNOWN], 1);
+    CU_ASSERT_EQUAL(stats.op_lines[INST_ORI], 0);
+
+    /** Only mnemonics that appeared are listed. **/
+    char buf[512];
+    stats.symbols = 2;
+    f = tmpfile();
+    write_stats_json(f, "a\"b.s", &stats);
+    rewind(f);
+    buf[fread(buf, 1, sizeof(buf) - 1, f)] = '\0';
+    fclose(f);
+    CU_ASSERT_EQUAL(strncmp(buf, "{\"file\": \"a\\\"b.s\", ", 16), 0);
+    CU_ASSERT_PTR_NOT_NULL(strstr(buf, "\"symbols\": 2,"));
+    CU_ASSERT_PTR_NOT_NULL(strstr(buf, "\"ops\": {\"unknown\": {\"lines\": 1, \"insts\": 1}, "
+        "\"addu\": {\"lines\": 1, \"insts\": 1}, \"li\": {\"lines\": 1, \"insts\": 2}}}"));
+    CU_ASSERT_PTR_NULL(strstr(buf, "ori"));
+
+    free_inst_list(insts);
+}
+
+/****************************************
+ *  Test cases for cache.c 
+ ****************************************/
+
+static int count_cached(const char* dir) {
+    char cmd[256];
+    snprintf(cmd, sizeof(cmd), "ls %s | grep -c '\\.obj$'", dir);
+    FILE* p = popen(cmd, "r");
+    int count = -1;
+    if (p) {
+        if (fscanf(p, "%d", &count) != 1) {
+            count = -1;
+        }
+        pclose(p);
+    }
+    return count;
+}
+
+void test_cache() {
+    char dir[] = "/tmp/test_cache_XXXXXX";
+    char key1[CACHE_KEY_SIZE], key2[CACHE_KEY_SIZE], key3[CACHE_KEY_SIZE];
+    char buf[256];
+    if (!mkdtemp(dir)) {
+        CU_FAIL("Could not create cache directory");
+        return;
+    }
+
+    /** Keys depend on both the contents and the salt. **/
+    FILE* src = tmpfile();
+    fputs("addu $t0 $t1 $t2\n", src);
+    fflush(src);
+    CU_ASSERT_EQUAL(cache_key(key1, src, "format 0"), 0);
+    CU_ASSERT_EQUAL(cache_key(key2, src, "format 0"), 0);
+    CU_ASSERT_EQUAL(cache_key(key3, src, "format 1"), 0);
+    CU_ASSERT_EQUAL(strlen(key1), CACHE_KEY_SIZE - 1);
+    CU_ASSERT_EQUAL(strcmp(key1, key2), 0);
+    CU_ASSERT_NOT_EQUAL(strcmp(key1, key3), 0);
+    CU_ASSERT_EQUAL(ftell(src), 0);
+    fputs("# more\n", src);
+    fflush(src);
+    CU_ASSERT_EQUAL(cache_key(key2, src, "format 0"), 0);
+    CU_ASSERT_NOT_EQUAL(strcmp(key1, key2), 0);
+    fclose(src);
+
+    /** A stored object is fetched byte for byte; other keys miss. **/
+    SymbolTable* symtbl = create_table(SYMTBL_UNIQUE_NAME);
+    SymbolTable* reltbl = create_table(SYMTBL_NON_UNIQUE);
+    Object* object = create_object(symtbl, reltbl, 0);
+    add_to_table(symtbl, "main", 0);
+    append_word(object, 0x01095021);
+    CU_ASSERT_EQUAL(cache_store(dir, key1, write_object_text, object, 0, 1 << 20), 0);
+    FILE* f = tmpfile();
+    CU_ASSERT_EQUAL(cache_fetch(dir, key1, f), 1);
+    rewind(f);
+    buf[fread(buf, 1, sizeof(buf) - 1, f)] = '\0';
+    CU_ASSERT_EQUAL(strcmp(buf, ".text\n01095021\n\n.symbol\n0\tmain\n\n.relocation\n"), 0);
+    fclose(f);
+    f = tmpfile();
+    CU_ASSERT_EQUAL(cache_fetch(dir, key3, f), 0);
+    CU_ASSERT_EQUAL(ftell(f), 0);
+    fclose(f);
+    CU_ASSERT_EQUAL(count_cached(dir), 1);
+
+    /** Past the size bound, the least recently used objects go first. **/
+    CU_ASSERT_EQUAL(cache_store(dir, key2, write_object_text, object, 0, 1 << 20), 0);
+    f = tmpfile();
+    CU_ASSERT_EQUAL(cache_fetch(dir, key1, f), 1);
+    fclose(f);
+    CU_ASSERT_EQUAL(cache_store(dir, key3, write_object_text, object, 0, 2 * strlen(buf)), 0);
+    CU_ASSERT_EQUAL(count_cached(dir), 2);
+    f = tmpfile();
+    CU_ASSERT_EQUAL(cache_fetch(dir, key2, f), 0);
+    CU_ASSERT_EQUAL(cache_fetch(dir, key1, f), 1);
+    CU_ASSERT_EQUAL(cache_fetch(dir, key3, f), 1);
+    fclose(f);
+
+    free_object(object);
+    free_table(symtbl);
+    free_table(reltbl);
+    snprintf(buf, sizeof(buf), "rm -rf %s", dir);
+    CU_ASSERT_EQUAL(system(buf), 0);
+}
+
+/****************************************
+ *  Test cases for relax.c 
+ ****************************************/
+
+void test_relax_branches() {
+    InstList* insts = create_inst_list(0);
+    SymbolTable* symtbl = create_table(SYMTBL_UNIQUE_NAME);
+    char* addu_args[] = {"$t0", "$t1", "$t2"};
+    char* end_args[] = {"$t0", "$t1", "end"};
+    char* top_args[] = {"$t2", "$t3", "top"};
+    uint32_t word;
+
+    /** The branch to end is exactly in reach until the branch to top, which
+        is out of reach, is rewritten before end and moves it. **/
+    add_to_table(symtbl, "top", 0);
+    expand_pass_one(insts, 1, "addu", addu_args, 3);
+    expand_pass_one(insts, 2, "beq", end_args, 3);
+    for (int i = 2; i < 32768; i++) {
+        expand_pass_one(insts, 3, "addu", addu_args, 3);
+    }
+    expand_pass_one(insts, 4, "bne", top_args, 3);
+    add_to_table(symtbl, "end", 4 * insts->len);
+    expand_pass_one(insts, 5, "addu", addu_args, 3);
+    CU_ASSERT_EQUAL(get_addr_for_symbol(symtbl, "end"), 131076);
+
+    CU_ASSERT_EQUAL(relax_branches(insts, symtbl), 2);
+    CU_ASSERT_EQUAL(insts->len, 32772);
+    CU_ASSERT_EQUAL(get_addr_for_symbol(symtbl, "top"), 0);
+    CU_ASSERT_EQUAL(get_addr_for_symbol(symtbl, "end"), 131084);
+
+    /** Each becomes the inverted branch over a jump to the label. **/
+    CU_ASSERT_EQUAL(insts->insts[1].op, INST_BNE);
+    CU_ASSERT_EQUAL(insts->insts[1].line, 2);
+    CU_ASSERT_EQUAL(encode_inst(&word, &insts->insts[1], 4, symtbl, NULL), 0);
+    CU_ASSERT_EQUAL(word, 0x15090001);
+    CU_ASSERT_EQUAL(insts->insts[2].op, INST_J);
+    CU_ASSERT_EQUAL(strcmp(insts->insts[2].args[0].text, "end"), 0);
+    CU_ASSERT_EQUAL(insts->insts[32769].op, INST_BEQ);
+    CU_ASSERT_EQUAL(encode_inst(&word, &insts->insts[32769], 131076, symtbl, NULL), 0);
+    CU_ASSERT_EQUAL(word, 0x114b0001);
+    CU_ASSERT_EQUAL(insts->insts[32770].op, INST_J);
+    CU_ASSERT_EQUAL(insts->insts[32770].line, 4);
+    CU_ASSERT_EQUAL(insts->insts[32771].op, INST_ADDU);
+
+    /** Nothing moves once every branch is in reach. **/
+    CU_ASSERT_EQUAL(relax_branches(insts, symtbl), 0);
+    CU_ASSERT_EQUAL(insts->len, 32772);
+
+    free_inst_list(insts);
+    free_table(symtbl);
+}
+
+/****************************************
+ *  Test cases for peephole.c 
+ ****************************************/
+
+void test_optimize_insts() {
+    InstList* insts = create_inst_list(0);
+    SymbolTable* symtbl = create_table(SYMTBL_UNIQUE_NAME);
+    char* li1_args[] = {"$t0", "0x12345678"};
+    char* li2_args[] = {"$t1", "0x1234abcd"};
+    char* li3_args[] = {"$t2", "40000"};
+    char* li4_args[] = {"$t3", "0x10000"};
+    char* move_args[] = {"$t0", "$t1"};
+    char* self_args[] = {"$t0", "$t0"};
+    char* nop_args[] = {"$zero", "$zero", "0"};
+    char* beq_args[] = {"$t0", "$t1", "end"};
+    uint32_t word;
+
+    expand_pass_one(insts, 1, "li", li1_args, 2);
+    expand_pass_one(insts, 2, "li", li2_args, 2);
+    expand_pass_one(insts, 3, "move", move_args, 2);
+    expand_pass_one(insts, 4, "move", self_args, 2);
+    expand_pass_one(insts, 5, "swpr", self_args, 2);
+    expand_pass_one(insts, 6, "sll", nop_args, 3);
+    add_to_table(symtbl, "mid", 4 * insts->len);
+    expand_pass_one(insts, 7, "li", li2_args, 2);
+    expand_pass_one(insts, 8, "li", li3_args, 2);
+    expand_pass_one(insts, 9, "li", li4_args, 2);
+    expand_pass_one(insts, 10, "beq", beq_args, 3);
+    add_to_table(symtbl, "end", 4 * insts->len);
+    CU_ASSERT_EQUAL(insts->len, 17);
+    CU_ASSERT_EQUAL(get_addr_for_symbol(symtbl, "mid"), 40);
+
+    /** The second lui $at, the self-moves and half of each short li go. **/
+    CU_ASSERT_EQUAL(optimize_insts(insts, symtbl), 6);
+    CU_ASSERT_EQUAL(insts->len, 11);
+    CU_ASSERT_EQUAL(get_addr_for_symbol(symtbl, "mid"), 24);
+    CU_ASSERT_EQUAL(get_addr_for_symbol(symtbl, "end"), 44);
+
+    CU_ASSERT_EQUAL(insts->insts[1].line, 1);
+    CU_ASSERT_EQUAL(insts->insts[2].op, INST_ORI);
+    CU_ASSERT_EQUAL(insts->insts[2].line, 2);
+
+    /** move becomes addu, and swpr $t0 $t0 keeps only its first step. **/
+    CU_ASSERT_EQUAL(insts->insts[3].op, INST_ADDU);
+    CU_ASSERT_EQUAL(encode_inst(&word, &insts->insts[3], 12, symtbl, NULL), 0);
+    CU_ASSERT_EQUAL(word, 0x01204021);
+    CU_ASSERT_EQUAL(insts->insts[4].op, INST_ADDU);
+    CU_ASSERT_EQUAL(insts->insts[4].line, 5);
+    CU_ASSERT_EQUAL(insts->insts[5].op, INST_SLL);
+
+    /** $at is forgotten at a label, so li after mid loads it again. **/
+    CU_ASSERT_EQUAL(insts->insts[6].op, INST_LUI);
+    CU_ASSERT_EQUAL(insts->insts[6].line, 7);
+    CU_ASSERT_EQUAL(encode_inst(&word, &insts->insts[8], 32, symtbl, NULL), 0);
+    CU_ASSERT_EQUAL(word, 0x340a9c40);
+    CU_ASSERT_EQUAL(encode_inst(&word, &insts->insts[9], 36, symtbl, NULL), 0);
+    CU_ASSERT_EQUAL(word, 0x3c0b0001);
+    CU_ASSERT_EQUAL(insts->insts[9].line, 9);
+
+    /** The branch names its label, so it still lands right after it. **/
+    CU_ASSERT_EQUAL(encode_inst(&word, &insts->insts[10], 40, symtbl, NULL), 0);
+    CU_ASSERT_EQUAL(word, 0x11090000);
+
+    /** There is nothing left to do the second time. **/
+    CU_ASSERT_EQUAL(optimize_insts(insts, symtbl), 0);
+    CU_ASSERT_EQUAL(insts->len, 11);
+
+    free_inst_list(insts);
+    free_table(symtbl);
+}
+
+/****************************************
+ *  Test cases for intern.c 
+ ****************************************/
+
+void test_interner() {
+    Interner* interner = create_interner(0);
+    char buf[16];
+
+    /** IDs count up from 0 in order of first use, and are kept on growth. **/
+    for (int i = 0; i < 1000; i++) {
+        sprintf(buf, "L%d", i % 300);
+        CU_ASSERT_EQUAL(intern_name(interner, buf, strlen(buf), NULL), (uint32_t) (i % 300));
+    }
+    CU_ASSERT_EQUAL(interner->len, 300);
+    CU_ASSERT_EQUAL(find_name(interner, "L299", 4, NULL), 299);
+    CU_ASSERT_EQUAL(find_name(interner, "L2999", 4, NULL), 299);
+    CU_ASSERT_EQUAL(find_name(interner, "L300", 4, NULL), -1);
+    CU_ASSERT_EQUAL(strcmp(interned_name(interner, 42), "L42"), 0);
+
+    /** Probes are only counted when asked for. **/
+    uint64_t probes = 0;
+    CU_ASSERT_EQUAL(find_name(interner, "L7", 2, &probes), 7);
+    CU_ASSERT(probes >= 1);
+
+    /** A shared interner lives until its last user lets go. **/
+    CU_ASSERT_PTR_EQUAL(share_interner(interner), interner);
+    free_interner(interner);
+    CU_ASSERT_EQUAL(strcmp(interned_name(interner, 0), "L0"), 0);
+    free_interner(interner);
+}
+
+/****************************************
+ *  Test cases for object.c 
+ ****************************************/
+
+void test_write_object_binary() {
+    SymbolTable* symtbl = create_table(SYMTBL_UNIQUE_NAME);
+    SymbolTable* reltbl = create_table(SYMTBL_NON_UNIQUE);
+    Object* object = create_object(symtbl, reltbl, 0);
+    unsigned char buf[64];
+
+    add_to_table(symtbl, "main", 0);
+    add_to_table(reltbl, "f", 4);
+    append_word(object, 0x8fa8fffc);
+    append_word(object, 0x0c000000);
+    CU_ASSERT_EQUAL(object->len, 2);
+
+    /** Header, two words, two 8-byte records and "main\0f\0". **/
+    FILE* f = tmpfile();
+    CU_ASSERT_EQUAL(write_object_binary(f, object, 1), 0);
+    rewind(f);
+    CU_ASSERT_EQUAL(fread(buf, 1, sizeof(buf), f), 24 + 8 + 16 + 7);
+    CU_ASSERT_EQUAL(memcmp(buf, "MOBJ", 4), 0);
+    CU_ASSERT_EQUAL(buf[5], 1);
+    CU_ASSERT_EQUAL(buf[11], 2);
+    CU_ASSERT_EQUAL(buf[24], 0x8f);
+    CU_ASSERT_EQUAL(buf[27], 0xfc);
+    CU_ASSERT_EQUAL(buf[47], 5);
+    CU_ASSERT_EQUAL(memcmp(buf + 48, "main\0f\0", 7), 0);
+    fclose(f);
+
+    /** Little endian flips the byte order of every word. **/
+    f = tmpfile();
+    CU_ASSERT_EQUAL(write_object_binary(f, object, 0), 0);
+    rewind(f);
+    CU_ASSERT_EQUAL(fread(buf, 1, sizeof(buf), f), 24 + 8 + 16 + 7);
+    CU_ASSERT_EQUAL(buf[5], 0);
+    CU_ASSERT_EQUAL(buf[8], 2);
+    CU_ASSERT_EQUAL(buf[24], 0xfc);
+    fclose(f);
+
+    free_object(object);
+    free_table(symtbl);
+    free_table(reltbl);
+}
+
+void test_resolve_local_jumps() {
+    SymbolTable* symtbl = create_table(SYMTBL_UNIQUE_NAME);
+    SymbolTable* reltbl = create_table(SYMTBL_NON_UNIQUE);
+    Object* object = create_object(symtbl, reltbl, 0);
+    char buf[256];
+
+    add_to_table(symtbl, "main", 0);
+    add_to_table(symtbl, "loop", 8);
+    add_to_table(reltbl, "loop", 4);
+    add_to_table(reltbl, "printf", 8);
+    add_to_table(reltbl, "main", 12);
+    add_to_table(reltbl, "printf", 16);
+    append_word(object, 0x012a4021);
+    append_word(object, 0x08000000);
+    append_word(object, 0x0c000000);
+    append_word(object, 0x0c000000);
+    append_word(object, 0x0c000000);
+
+    /** Jumps to labels of the object get their targets and leave .relocation. **/
+    CU_ASSERT_EQUAL(resolve_local_jumps(object), 2);
+    CU_ASSERT_EQUAL(object->text[1], 0x08000002);
+    CU_ASSERT_EQUAL(object->text[2], 0x0c000000);
+    CU_ASSERT_EQUAL(object->text[3], 0x0c000000);
+    CU_ASSERT_EQUAL(reltbl->len, 2);
+    CU_ASSERT_EQUAL(get_addr_for_symbol(reltbl, "printf"), 8);
+    CU_ASSERT_EQUAL(get_addr_for_symbol(reltbl, "main"), -1);
+    CU_ASSERT_EQUAL(reltbl->tbl[1].addr, 16);
+    CU_ASSERT_EQUAL(object->textrel_len, 2);
+    CU_ASSERT_EQUAL(object->textrel[0], 4);
+    CU_ASSERT_EQUAL(object->textrel[1], 12);
+
+    FILE* f = tmpfile();
+    CU_ASSERT_EQUAL(write_object_text(f, object, 0), 0);
+    rewind(f);
+    size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+    buf[n] = '\0';
+    CU_ASSERT_PTR_NOT_NULL(strstr(buf, "\n.relocation\n8\tprintf\n16\tprintf\n"
+        "\n.textrel\n4\t.text\n12\t.text\n"));
+    fclose(f);
+
+    /** Nothing is left to resolve the second time. **/
+    CU_ASSERT_EQUAL(resolve_local_jumps(object), 0);
+    CU_ASSERT_EQUAL(object->textrel_len, 2);
+
+    free_object(object);
+    free_table(symtbl);
+    free_table(reltbl);
+
+    /** A line that fails to encode is left out, so later relocation offsets
+        no longer match the words, and those words are not patched. **/
+    symtbl = create_table(SYMTBL_UNIQUE_NAME);
+    reltbl = create_table_sharing(SYMTBL_NON_UNIQUE, symtbl);
+    InstList* insts = create_inst_list(0);
+    f = tmpfile();
+    fputs("a: addu $t0 $t1 $t2\nbeq $t0 $t1 nowhere\naddu $t0 $t1 $t2\nj a\n"
+        "addu $t3 $t3 $t3\n", f);
+    rewind(f);
+    set_log_file(TMP_FILE);
+    CU_ASSERT_EQUAL(pass_one_ir(f, insts, symtbl), 0);
+    fclose(f);
+    object = create_object(symtbl, reltbl, 0);
+    CU_ASSERT_EQUAL(pass_two_ir(insts, object), -1);
+    CU_ASSERT_EQUAL(object->len, 4);
+    CU_ASSERT_EQUAL(resolve_local_jumps(object), 0);
+    CU_ASSERT_EQUAL(object->text[2], 0x08000000);
+    CU_ASSERT_EQUAL(object->text[3], 0x016b5821);
+    CU_ASSERT_EQUAL(object->textrel_len, 0);
+    CU_ASSERT_EQUAL(reltbl->len, 1);
+
+    free_object(object);
+    free_inst_list(insts);
+    free_table(symtbl);
+    free_table(reltbl);
+
+    /** assemble() does not resolve jumps of an input with errors. **/
+    write_file("test_local_jumps.s", "a: addu $t0 $t1 $t2\nbad $t0\n"
+        "addu $t0 $t1 $t2\nj a\naddu $t3 $t3 $t3\n");
+    AssemblerOptions options = {OBJ_FORMAT_TEXT, 0, 1, NULL, NULL, 0, 0, 1};
+    CU_ASSERT_EQUAL(assemble("test_local_jumps.s", NULL, "test_local_jumps.o", &options), 1);
+    f = fopen("test_local_jumps.o", "r");
+    CU_ASSERT_PTR_NOT_NULL(f);
+    if (f) {
+        n = fread(buf, 1, sizeof(buf) - 1, f);
+        buf[n] = '\0';
+        CU_ASSERT_EQUAL(strcmp(buf, ".text\n012a4021\n012a4021\n08000000\n016b5821\n"
+            "\n.symbol\n0\ta\n\n.relocation\n12\ta\n"), 0);
+        fclose(f);
+    }
+    unlink("test_local_jumps.s");
+    unlink("test_local_jumps.o");
+}
+
+/****************************************
+ *  Test cases for assembler.c 
+ ****************************************/
+
+void test_assemble_batch() {
+    write_file("test_batch_good.s", "main: addiu $t0 $t0 1\njal main\n");
+    unlink("test_batch_missing.s");
+    AssemblyJob jobs[2] = {{0}};
+    jobs[0].in_name = "test_batch_missing.s";
+    jobs[0].out_name = "test_batch_missing.o";
+    jobs[1].in_name = "test_batch_good.s";
+    jobs[1].out_name = "test_batch_good.o";
+    AssemblerOptions options = {OBJ_FORMAT_TEXT, 0, 2, NULL, NULL, 0, 0, 0};
+
+    /** A missing input fails its job without stopping the others, and the
+        logs come out in input order. **/
+    set_log_file(TMP_FILE);
+    CU_ASSERT_EQUAL(assemble_batch(jobs, 2, &options), 1);
+    CU_ASSERT_EQUAL(jobs[0].err, 1);
+    CU_ASSERT_EQUAL(jobs[1].err, 0);
+    char* arr[] = {"Error: unable to open input file: test_batch_missing.s",
+        "Errors encountered while assembling test_batch_missing.s"};
+    check_lines_equal(arr, 2);
+
+    char buf[128];
+    FILE* f = fopen("test_batch_good.o", "r");
+    CU_ASSERT_PTR_NOT_NULL(f);
+    if (f) {
+        size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+        buf[n] = '\0';
+        CU_ASSERT_EQUAL(strcmp(buf, ".text\n25080001\n0c000000\n\n.symbol\n0\tmain\n"
+            "\n.relocation\n4\tmain\n"), 0);
+        fclose(f);
+    }
+    CU_ASSERT_EQUAL(access("test_batch_missing.o", F_OK), -1);
+
+    for (int i = 0; i < 2; i++) {
+        free_log_buffer(&jobs[i].log);
+    }
+    unlink("test_batch_good.s");
+    unlink("test_batch_good.o");
+}
+
+void test_read_manifest() {
+    write_file("test_manifest.txt", "# inputs and outputs\na.s a.o\n\n"
+        "  b.s\tb.o  # the second\n");
+    AssemblyJob* jobs = NULL;
+    CU_ASSERT_EQUAL(read_manifest("test_manifest.txt", &jobs), 2);
+    CU_ASSERT_EQUAL(strcmp(jobs[0].in_name, "a.s"), 0);
+    CU_ASSERT_EQUAL(strcmp(jobs[0].out_name, "a.o"), 0);
+    CU_ASSERT_EQUAL(strcmp(jobs[1].in_name, "b.s"), 0);
+    CU_ASSERT_EQUAL(strcmp(jobs[1].out_name, "b.o"), 0);
+    for (int i = 0; i < 2; i++) {
+        free((char *) jobs[i].in_name);
+        free((char *) jobs[i].out_name);
+    }
+    free(jobs);
+
+    /** A line with one file name is an error. **/
+    write_file("test_manifest.txt", "a.s a.o\nb.s\n");
+    set_log_file(TMP_FILE);
+    jobs = NULL;
+    CU_ASSERT_EQUAL(read_manifest("test_manifest.txt", &jobs), -1);
+    char* arr[] = {"Error - invalid manifest entry at line 2"};
+    check_lines_equal(arr, 1);
+    free((char *) jobs[0].in_name);
+    free((char *) jobs[0].out_name);
+    free(jobs);
+    unlink("test_manifest.txt");
+}
+
+void test_batch_error_limit() {
+    write_file("test_batch_1.s", "addu $t0 $t1\nfoo $t0\nori $t0 $t0 99999\n");
+    write_file("test_batch_2.s", "blah\nblah\naddu $t0\n");
+    AssemblyJob jobs[2] = {{0}};
+    jobs[0].in_name = "test_batch_1.s";
+    jobs[0].out_name = "test_batch_1.o";
+    jobs[1].in_name = "test_batch_2.s";
+    jobs[1].out_name = "test_batch_2.o";
+    AssemblerOptions options = {OBJ_FORMAT_TEXT, 0, 2, NULL, NULL, 0, 0, 0};
+
+    /** The errors of every job count toward one limit, but each failed
+        file is still named. **/
+    set_log_file(TMP_FILE);
+    set_error_limit(1);
+    CU_ASSERT_EQUAL(assemble_batch(jobs, 2, &options), 2);
+    char* arr[] = {"Error - invalid instruction at line 1: addu $t0 $t1",
+        "(2 more errors not shown)", "Errors encountered while assembling test_batch_1.s",
+        "(3 more errors not shown)", "Errors encountered while assembling test_batch_2.s"};
+    check_lines_equal(arr, 5);
+    set_error_limit(0);
+
+    for (int i = 0; i < 2; i++) {
+        free_log_buffer(&jobs[i].log);
+    }
+    unlink("test_batch_1.s");
+    unlink("test_batch_2.s");
+    unlink("test_batch_1.o");
+    unlink("test_batch_2.o");
+}
+
+/* Returns the contents of F, which the caller must free. */
+static char* read_all(FILE* f) {
+    long size = ftell(f);
+    char* text = (char *) malloc(size + 1);
+    rewind(f);
+    text[fread(text, 1, size, f)] = '\0';
+    return text;
+}
+
+/* Assembles SOURCE with pass_one_ir() and pass_two_ir() into a text object.
+   Returns the object, which the caller must free. */
+static char* assemble_two_pass(FILE* source) {
+    SymbolTable* symtbl = create_table(SYMTBL_UNIQUE_NAME);
+    SymbolTable* reltbl = create_table_sharing(SYMTBL_NON_UNIQUE, symtbl);
+    InstList* insts = create_inst_list(0);
+    rewind(source);
+    pass_one_ir(source, insts, symtbl);
+    Object* object = create_object(symtbl, reltbl, insts->len);
+    pass_two_ir(insts, object);
+
+    FILE* f = tmpfile();
+    write_object_text(f, object, 0);
+    char* text = read_all(f);
+    fclose(f);
+    free_object(object);
+    free_inst_list(insts);
+    free_table(symtbl);
+    free_table(reltbl);
+    return text;
+}
+
+/* Assembles SOURCE with assemble_stream(), storing what it returned in
+   *ERR. Returns the object, which the caller must free. */
+static char* assemble_streamed(FILE* source, int* err) {
+    FILE* f = tmpfile();
+    rewind(source);
+    *err = assemble_stream(source, f);
+    char* text = read_all(f);
+    fclose(f);
+    return text;
+}
+
+void test_pass_two_parallel() {
+    SymbolTable* symtbl = create_table(SYMTBL_UNIQUE_NAME);
+    InstList* insts = create_inst_list(0);
+    FILE* source = tmpfile();
+    const int count = 3 * 4096 + 7;
+    for (int i = 0; i < count; i++) {
+        if (i == 5500) {
+            fputs("beq $t0 $t1 nowhere\n", source);
+        } else if (i == 9500) {
+            fputs("bne $t0 $0 gone\n", source);
+        } else if (i % 1000 == 0) {
+            fprintf(source, "L%d: jal ext%d\n", i, i % 3000);
+        } else if (i % 1000 == 1) {
+            fprintf(source, "bne $t0 $0 L%d\n", i - 1);
+        } else {
+            fprintf(source, "addiu $t0 $t0 %d\n", i % 100);
+        }
+    }
+    rewind(source);
+    CU_ASSERT_EQUAL(pass_one_ir(source, insts, symtbl), 0);
+    fclose(source);
+
+    /** Splitting the instructions into chunks on several threads gives the
+        same text, relocations and errors as encoding them in order. **/
+    char* arr[] = {"Error - invalid instruction at line 5501: beq $t0 $t1 nowhere",
+        "Error - invalid instruction at line 9501: bne $t0 $zero gone"};
+    Object* objects[2];
+    int threads[2] = {1, 4};
+    for (int k = 0; k < 2; k++) {
+        SymbolTable* reltbl = create_table_sharing(SYMTBL_NON_UNIQUE, symtbl);
+        objects[k] = create_object(symtbl, reltbl, 0);
+        set_log_file(TMP_FILE);
+        CU_ASSERT_EQUAL(pass_two_parallel(insts, objects[k], threads[k]), -1);
+        check_lines_equal(arr, 2);
+    }
+    CU_ASSERT_EQUAL(objects[0]->len, count - 2);
+    CU_ASSERT_EQUAL(objects[1]->len, objects[0]->len);
+    CU_ASSERT_EQUAL(memcmp(objects[0]->text, objects[1]->text,
+        objects[0]->len * sizeof(uint32_t)), 0);
+
+    SymbolTable* serial = objects[0]->reltbl;
+    SymbolTable* parallel = objects[1]->reltbl;
+    CU_ASSERT_EQUAL(serial->len, 13);
+    CU_ASSERT_EQUAL(parallel->len, serial->len);
+    int same = 1;
+    for (uint32_t i = 0; i < serial->len && i < parallel->len; i++) {
+        same &= serial->tbl[i].addr == parallel->tbl[i].addr
+            && strcmp(symbol_name(serial, i), symbol_name(parallel, i)) == 0;
+    }
+    CU_ASSERT(same);
+
+    for (int k = 0; k < 2; k++) {
+        free_table(objects[k]->reltbl);
+        free_object(objects[k]);
+    }
+    free_inst_list(insts);
+    free_table(symtbl);
+}
+
+void test_assemble_stream() {
+    /** A forward branch holds back more than a chunk of words until its
+        label is defined, and the words after it are written in chunks. **/
+    FILE* source = tmpfile();
+    fputs("start: beq $t0 $t1 end\n", source);
+    for (int i = 0; i < 5000; i++) {
+        fputs("addiu $t0 $t0 1\n", source);
+    }
+    fputs("end: bne $t0 $0 start\njal start\nbeq $t1 $0 done\n", source);
+    for (int i = 0; i < 10000; i++) {
+        fputs("addiu $t1 $t1 1\n", source);
+    }
+    fputs("done: jal end\n", source);
+
+    int err;
+    char* streamed = assemble_streamed(source, &err);
+    char* expected = assemble_two_pass(source);
+    CU_ASSERT_EQUAL(err, 0);
+    CU_ASSERT_EQUAL(strcmp(streamed, expected), 0);
+    CU_ASSERT_EQUAL(strncmp(streamed, ".text\n11091388\n", 15), 0);
+    free(streamed);
+    free(expected);
+    fclose(source);
+
+    /** A branch whose label turns out to be out of reach is reported and
+        left out, as pass_two_ir() does. **/
+    source = tmpfile();
+    fputs("beq $t0 $t1 far\n", source);
+    for (int i = 0; i < 32768; i++) {
+        fputs("addiu $t0 $t0 1\n", source);
+    }
+    fputs("far: jal far\n", source);
+
+    set_log_file(TMP_FILE);
+    streamed = assemble_streamed(source, &err);
+    CU_ASSERT_EQUAL(err, -1);
+    char* arr[] = {"Error - invalid instruction at line 1: beq $t0 $t1 far"};
+    check_lines_equal(arr, 1);
+    set_log_file(TMP_FILE);
+    expected = assemble_two_pass(source);
+    check_lines_equal(arr, 1);
+    CU_ASSERT_EQUAL(strcmp(streamed, expected), 0);
+    CU_ASSERT_EQUAL(strncmp(streamed, ".text\n25080001\n", 15), 0);
+    free(streamed);
+    free(expected);
+    fclose(source);
+}
+
 int main(int argc, char** argv) {
-    CU_pSuite pSuite1 = NULL, pSuite2 = NULL, pSuite3 = NULL;
+    CU_pSuite pSuite1 = NULL, pSuite2 = NULL, pSuite3 = NULL, pSuite4 = NULL,
+        pSuite5 = NULL, pSuite6 = NULL, pSuite7 = NULL, pSuite8 = NULL,
+        pSuite9 = NULL, pSuite10 = NULL, pSuite11 = NULL, pSuite12 = NULL,
+        pSuite13 = NULL, pSuite14 = NULL;
 
     if (CUE_SUCCESS != CU_initialize_registry()) {
         return CU_get_error();
@@ -241,6 +1313,12 @@ int main(int argc, char** argv) {
     if (!CU_add_test(pSuite2, "test_table_2", test_table_2)) {
         goto exit;
     }
+    if (!CU_add_test(pSuite2, "test_table_3", test_table_3)) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite2, "test_table_sharing", test_table_sharing)) {
+        goto exit;
+    }
 
     /* Suite 3 */
     pSuite3 = CU_add_suite("Testing translate.c", NULL, NULL);
@@ -250,6 +1328,132 @@ int main(int argc, char** argv) {
     if (!CU_add_test(pSuite3, "test_write_pass_one", test_write_pass_one)) {
         goto exit;
     }
+    if (!CU_add_test(pSuite3, "test_expand_pass_one", test_expand_pass_one)) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite3, "test_find_inst", test_find_inst)) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite3, "test_translate_inst", test_translate_inst)) {
+        goto exit;
+    }
+
+    /* Suite 4 */
+    pSuite4 = CU_add_suite("Testing object.c", NULL, NULL);
+    if (!pSuite4) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite4, "test_write_object_binary", test_write_object_binary)) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite4, "test_resolve_local_jumps", test_resolve_local_jumps)) {
+        goto exit;
+    }
+
+    /* Suite 5 */
+    pSuite5 = CU_add_suite("Testing lexer.c", NULL, NULL);
+    if (!pSuite5) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite5, "test_next_line", test_next_line)) {
+        goto exit;
+    }
+
+    /* Suite 6 */
+    pSuite6 = CU_add_suite("Testing parallel.c", NULL, NULL);
+    if (!pSuite6) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite6, "test_run_tasks", test_run_tasks)) {
+        goto exit;
+    }
+
+    /* Suite 7 */
+    pSuite7 = CU_add_suite("Testing utils.c", NULL, NULL);
+    if (!pSuite7) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite7, "test_capture_log", test_capture_log)) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite7, "test_error_limit", test_error_limit)) {
+        goto exit;
+    }
+
+    /* Suite 8 */
+    pSuite8 = CU_add_suite("Testing writer.c", NULL, NULL);
+    if (!pSuite8) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite8, "test_write_hex_words", test_write_hex_words)) {
+        goto exit;
+    }
+
+    /* Suite 9 */
+    pSuite9 = CU_add_suite("Testing stats.c", NULL, NULL);
+    if (!pSuite9) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite9, "test_count_source_stats", test_count_source_stats)) {
+        goto exit;
+    }
+
+    /* Suite 10 */
+    pSuite10 = CU_add_suite("Testing cache.c", NULL, NULL);
+    if (!pSuite10) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite10, "test_cache", test_cache)) {
+        goto exit;
+    }
+
+    /* Suite 11 */
+    pSuite11 = CU_add_suite("Testing relax.c", NULL, NULL);
+    if (!pSuite11) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite11, "test_relax_branches", test_relax_branches)) {
+        goto exit;
+    }
+
+    /* Suite 12 */
+    pSuite12 = CU_add_suite("Testing peephole.c", NULL, NULL);
+    if (!pSuite12) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite12, "test_optimize_insts", test_optimize_insts)) {
+        goto exit;
+    }
+
+    /* Suite 13 */
+    pSuite13 = CU_add_suite("Testing intern.c", NULL, NULL);
+    if (!pSuite13) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite13, "test_interner", test_interner)) {
+        goto exit;
+    }
+
+    /* Suite 14 */
+    pSuite14 = CU_add_suite("Testing assembler.c", NULL, NULL);
+    if (!pSuite14) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite14, "test_assemble_batch", test_assemble_batch)) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite14, "test_read_manifest", test_read_manifest)) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite14, "test_batch_error_limit", test_batch_error_limit)) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite14, "test_pass_two_parallel", test_pass_two_parallel)) {
+        goto exit;
+    }
+    if (!CU_add_test(pSuite14, "test_assemble_stream", test_assemble_stream)) {
+        goto exit;
+    }
     
     /**if (!CU_add_test(pSuite2, "test_table_2", test_table_2)) {
         goto exit;
@@ -10,6 +10,121 @@
 /* SOLUTION CODE BELOW */
 const int TWO_POW_SEVENTEEN = 131072;    // 2^17
 
+static unsigned expand_li(InstList* out, uint32_t line, const InstDesc* desc,
+    const Token* args);
+static unsigned expand_steps(InstList* out, uint32_t line, const InstDesc* desc,
+    const Token* args);
+
+/* Pseudoinstruction expansions. Each step is one instruction of the expansion;
+   its operands are taken from the pseudoinstruction's arguments or are $at or
+   $zero. */
+static const PseudoStep MOVE_STEPS[] = {
+    {INST_ADD, {STEP_ARG0, STEP_ARG1, STEP_ZERO}}
+};
+static const PseudoStep BLT_STEPS[] = {
+    {INST_SLT, {STEP_AT, STEP_ARG0, STEP_ARG1}},
+    {INST_BNE, {STEP_AT, STEP_ZERO, STEP_ARG2}}
+};
+static const PseudoStep BGT_STEPS[] = {
+    {INST_SLT, {STEP_AT, STEP_ARG1, STEP_ARG0}},
+    {INST_BNE, {STEP_AT, STEP_ZERO, STEP_ARG2}}
+};
+static const PseudoStep TRADDU_STEPS[] = {
+    {INST_ADDU, {STEP_AT, STEP_ARG1, STEP_ARG2}},
+    {INST_ADDU, {STEP_ARG0, STEP_ARG0, STEP_AT}}
+};
+static const PseudoStep SWPR_STEPS[] = {
+    {INST_ADD, {STEP_AT, STEP_ZERO, STEP_ARG1}},
+    {INST_ADD, {STEP_ARG1, STEP_ARG0, STEP_ZERO}},
+    {INST_ADD, {STEP_ARG0, STEP_AT, STEP_ZERO}}
+};
+static const PseudoStep MUL_STEPS[] = {
+    {INST_MULT, {STEP_ARG1, STEP_ARG2}},
+    {INST_MFLO, {STEP_ARG0}}
+};
+static const PseudoStep DIV_STEPS[] = {
+    {INST_DIV, {STEP_ARG1, STEP_ARG2}},
+    {INST_MFLO, {STEP_ARG0}}
+};
+static const PseudoStep REM_STEPS[] = {
+    {INST_DIV, {STEP_ARG1, STEP_ARG2}},
+    {INST_MFHI, {STEP_ARG0}}
+};
+
+#define STEPS(steps) sizeof(steps) / sizeof(steps[0]), steps, expand_steps
+
+/* Every instruction the assembler knows, indexed by InstOp. Adding an
+   instruction means adding an entry here (and to InstOp and INST_SLOTS). */
+static const InstDesc INST_TABLE[NUM_INST_OPS] = {
+    /*             name      len format      op    funct args fields */
+    [INST_ADDU]  = {"addu",   4, FMT_R,      0x00, 0x21, 3, {FIELD_RD, FIELD_RS, FIELD_RT}},
+    [INST_OR]    = {"or",     2, FMT_R,      0x00, 0x25, 3, {FIELD_RD, FIELD_RS, FIELD_RT}},
+    [INST_SLT]   = {"slt",    3, FMT_R,      0x00, 0x2a, 3, {FIELD_RD, FIELD_RS, FIELD_RT}},
+    [INST_SLTU]  = {"sltu",   4, FMT_R,      0x00, 0x2b, 3, {FIELD_RD, FIELD_RS, FIELD_RT}},
+    [INST_SLL]   = {"sll",    3, FMT_R,      0x00, 0x00, 3, {FIELD_RD, FIELD_RT, FIELD_SHAMT}},
+    [INST_JR]    = {"jr",     2, FMT_R,      0x00, 0x08, 1, {FIELD_RS}},
+    [INST_ADDIU] = {"addiu",  5, FMT_I,      0x09, 0x00, 3, {FIELD_RT, FIELD_RS, FIELD_SIMM}},
+    [INST_ORI]   = {"ori",    3, FMT_I,      0x0d, 0x00, 3, {FIELD_RT, FIELD_RS, FIELD_UIMM}},
+    [INST_LUI]   = {"lui",    3, FMT_I,      0x0f, 0x00, 2, {FIELD_RT, FIELD_UIMM}},
+    [INST_LB]    = {"lb",     2, FMT_I,      0x20, 0x00, 3, {FIELD_RT, FIELD_SIMM, FIELD_RS}},
+    [INST_LW]    = {"lw",     2, FMT_I,      0x23, 0x00, 3, {FIELD_RT, FIELD_SIMM, FIELD_RS}},
+    [INST_LBU]   = {"lbu",    3, FMT_I,      0x24, 0x00, 3, {FIELD_RT, FIELD_SIMM, FIELD_RS}},
+    [INST_SB]    = {"sb",     2, FMT_I,      0x28, 0x00, 3, {FIELD_RT, FIELD_SIMM, FIELD_RS}},
+    [INST_SW]    = {"sw",     2, FMT_I,      0x2b, 0x00, 3, {FIELD_RT, FIELD_SIMM, FIELD_RS}},
+    [INST_BEQ]   = {"beq",    3, FMT_BRANCH, 0x04, 0x00, 3, {FIELD_RS, FIELD_RT, FIELD_LABEL}},
+    [INST_BNE]   = {"bne",    3, FMT_BRANCH, 0x05, 0x00, 3, {FIELD_RS, FIELD_RT, FIELD_LABEL}},
+    [INST_J]     = {"j",      1, FMT_JUMP,   0x02, 0x00, 1, {FIELD_LABEL}},
+    [INST_JAL]   = {"jal",    3, FMT_JUMP,   0x03, 0x00, 1, {FIELD_LABEL}},
+    [INST_ADD]   = {"add",    3, FMT_R,      0x00, 0x20, 3, {FIELD_RD, FIELD_RS, FIELD_RT}},
+    [INST_MULT]  = {"mult",   4, FMT_R,      0x00, 0x18, 2, {FIELD_RS, FIELD_RT}},
+    [INST_DIV]   = {"div",    3, FMT_R,      0x00, 0x1a, 2, {FIELD_RS, FIELD_RT}, 3, STEPS(DIV_STEPS)},
+    [INST_MFLO]  = {"mflo",   4, FMT_R,      0x00, 0x12, 1, {FIELD_RD}},
+    [INST_MFHI]  = {"mfhi",   4, FMT_R,      0x00, 0x10, 1, {FIELD_RD}},
+    /*             name      len format      op    funct args fields pseudo args, expansion */
+    [INST_LI]    = {"li",     2, FMT_PSEUDO, 0, 0, 0, {0}, 2, 0, NULL, expand_li},
+    [INST_MOVE]  = {"move",   4, FMT_PSEUDO, 0, 0, 0, {0}, 2, STEPS(MOVE_STEPS)},
+    [INST_BLT]   = {"blt",    3, FMT_PSEUDO, 0, 0, 0, {0}, 3, STEPS(BLT_STEPS)},
+    [INST_BGT]   = {"bgt",    3, FMT_PSEUDO, 0, 0, 0, {0}, 3, STEPS(BGT_STEPS)},
+    [INST_TRADDU]= {"traddu", 6, FMT_PSEUDO, 0, 0, 0, {0}, 3, STEPS(TRADDU_STEPS)},
+    [INST_SWPR]  = {"swpr",   4, FMT_PSEUDO, 0, 0, 0, {0}, 2, STEPS(SWPR_STEPS)},
+    [INST_MUL]   = {"mul",    3, FMT_PSEUDO, 0, 0, 0, {0}, 3, STEPS(MUL_STEPS)},
+    [INST_REM]   = {"rem",    3, FMT_PSEUDO, 0, 0, 0, {0}, 3, STEPS(REM_STEPS)},
+};
+
+/* Perfect hash of every mnemonic in INST_TABLE: INST_SLOTS[inst_hash(name)]
+   is the InstOp of NAME, or INST_UNKNOWN. When adding an instruction, pick a
+   free slot by computing inst_hash() of its name (test_find_inst checks that
+   every entry is reachable). */
+static const uint8_t INST_SLOTS[64] = {
+    [0] = INST_DIV, [2] = INST_LB, [5] = INST_SLL, [6] = INST_LI,
+    [7] = INST_BLT, [9] = INST_MFLO, [10] = INST_MULT, [11] = INST_TRADDU,
+    [14] = INST_LW, [16] = INST_SWPR, [20] = INST_OR, [21] = INST_J,
+    [23] = INST_ADDU, [24] = INST_ADDIU, [29] = INST_MOVE, [32] = INST_ORI,
+    [34] = INST_BNE, [35] = INST_REM, [40] = INST_MUL, [42] = INST_JAL,
+    [44] = INST_SB, [45] = INST_SLT, [51] = INST_SLTU, [54] = INST_JR,
+    [55] = INST_BEQ, [56] = INST_SW, [57] = INST_ADD, [58] = INST_LBU,
+    [59] = INST_LUI, [60] = INST_BGT, [63] = INST_MFHI
+};
+
+static unsigned inst_hash(const unsigned char* name, size_t len) {
+    return (len + 6 * name[0] + 13 * name[len - 1] + 15 * name[len >> 1]) & 63;
+}
+
+const InstDesc* find_inst(const char* name, size_t len) {
+    if (len == 0) {
+        return NULL;
+    }
+    const InstDesc* desc = &INST_TABLE[INST_SLOTS[inst_hash((const unsigned char *) name, len)]];
+    if (desc->len != len || memcmp(desc->name, name, len) != 0) {
+        return NULL;
+    }
+    return desc;
+}
+
+const InstDesc* inst_desc(int op) {
+    return &INST_TABLE[op];
+}
+
 /* Writes instructions during the assembler's first pass to OUTPUT. The case
    for general instructions has already been completed, but you need to write
    code to translate the li and blt pseudoinstructions. Your pseudoinstruction 
@@ -38,96 +153,182 @@ const int TWO_POW_SEVENTEEN = 131072;    // 2^17
    larger than the largest 32 bit number to be loaded with li. You should follow
    the above rules if MARS behaves differently.
 
-   Use fprintf() to write. If writing multiple instructions, make sure that 
-   each instruction is on a different line.
+   The expansion is built by expand_pass_one() and each resulting instruction
+   is written on its own line with write_inst().
 
    Returns the number of instructions written (so 0 if there were any errors).
  */
 unsigned write_pass_one(FILE* output, const char* name, char** args, int num_args) {
-    if (strcmp(name, "li") == 0) {
-        if (num_args == 2) {
-          long int new_imm;
-          long int lowest_signed_number = -2147483648;
-          long int highest_unsigned_number = 4294967295;
-          int success = translate_num(&new_imm, args[1], lowest_signed_number, highest_unsigned_number);
-          if (success == 0) {
-            long int lowest_signed_16bit_number = -32768;
-            long int highest_signed_16bit_number = 32767;
-            if (new_imm >= lowest_signed_16bit_number && new_imm <= highest_signed_16bit_number) {
-              fprintf(output, "addiu %s $zero %ld\n", args[0], new_imm);
-              return 1;
-            } else {
-              long int upper_bits = (new_imm >> 16);
-              long int highest_unsigned_16bit_number = 65535;
-              long int lower_bits = (new_imm & highest_unsigned_16bit_number);
-              fprintf(output, "lui $at %ld\n", upper_bits);
-              fprintf(output, "ori %s $at %ld\n", args[0], lower_bits);
-              return 2;
-            }
-          }
-          return 0;
-        }
-        return 0;  
-    } else if (strcmp(name, "move") == 0) {
-        if (num_args == 2) {
-          fprintf(output, "add %s %s $zero\n", args[0], args[1]);
-          return 1;
-        }
-        return 0;  
-    } else if (strcmp(name, "blt") == 0) {
-        if (num_args == 3) {
-          fprintf(output, "slt $at %s %s\n", args[0], args[1]);
-          fprintf(output, "bne $at $zero %s\n", args[2]);
-          return 2;
-        }
-        return 0;  
-    } else if (strcmp(name, "bgt") == 0) {
-        if (num_args == 3) {
-          fprintf(output, "slt $at %s %s\n", args[1], args[0]);
-          fprintf(output, "bne $at $zero %s\n", args[2]);
-          return 2;
-        }
-        return 0; 
-    } else if (strcmp(name, "traddu") == 0) {
-        if (num_args == 3) {
-          fprintf(output, "addu $at %s %s\n", args[1], args[2]);
-          fprintf(output, "addu %s %s $at\n", args[0], args[0]);
-          return 2;
-        }
-        return 0;       
-    } else if (strcmp(name, "swpr") == 0) {
-        if (num_args == 2) {
-          fprintf(output, "add $at $zero %s\n", args[1]);
-          fprintf(output, "add %s %s $zero\n", args[1], args[0]);
-          fprintf(output, "add %s $at $zero\n", args[0]);
-          return 3;
-        }
-        return 0;       
-    } else if (strcmp(name, "mul") == 0) {
-        if (num_args == 3) {
-          fprintf(output, "mult %s %s \n", args[1], args[2]);
-          fprintf(output, "mflo %s\n", args[0]);
-          return 2;
-        }
-        return 0;       
-    } else if (strcmp(name, "div") == 0) {
-        if (num_args == 3) {
-          fprintf(output, "div %s %s \n", args[1], args[2]);
-          fprintf(output, "mflo %s\n", args[0]);
-          return 2;
-        }
-        return 0;       
-    } else if (strcmp(name, "rem") == 0) {
-        if (num_args == 3) {
-          fprintf(output, "div %s %s \n", args[1], args[2]);
-          fprintf(output, "mfhi %s\n", args[0]);
-          return 2;
+    InstList* expansion = create_inst_list(0);
+    unsigned lines_written = expand_pass_one(expansion, 0, name, args, num_args);
+    for (uint32_t i = 0; i < expansion->len; i++) {
+        write_inst(output, &expansion->insts[i]);
+    }
+    free_inst_list(expansion);
+    return lines_written;
+}
+
+/* Makes token views of the NUM_ARGS strings in ARGS. */
+static void to_tokens(Token* tokens, char** args, int num_args) {
+    for (int i = 0; i < num_args; i++) {
+        tokens[i].ptr = args[i];
+        tokens[i].len = strlen(args[i]);
+    }
+}
+
+/* Same as write_pass_one(), but appends the expanded instructions to OUT
+   instead of writing them as text. LINE is recorded as the input line of
+   every appended instruction. Nothing is appended if an error occurs.
+
+   Returns the number of instructions appended (so 0 if there were any errors).
+ */
+unsigned expand_pass_one(InstList* out, uint32_t line, const char* name,
+    char** args, int num_args) {
+    Token tokens[INST_MAX_ARGS];
+    if (num_args > INST_MAX_ARGS || (num_args > 0 && !args)) {
+        return 0;
+    }
+    to_tokens(tokens, args, num_args);
+    Token name_token = {name, strlen(name)};
+    return expand_tokens(out, line, name_token, tokens, num_args);
+}
+
+/* Same as expand_pass_one(), for an instruction whose name and arguments are
+   token views of the source.
+ */
+unsigned expand_tokens(InstList* out, uint32_t line, Token name,
+    const Token* args, int num_args) {
+    const InstDesc* desc = find_inst(name.ptr, name.len);
+    if (desc && desc->pseudo_args) {
+        if (num_args == desc->pseudo_args) {
+            return desc->expand(out, line, desc, args);
+        } else if (desc->format == FMT_PSEUDO) {
+            return 0;
         }
-        return 0;      
-    } 
-    write_inst_string(output, name, args, num_args);
+    }
+    Inst inst;
+    decode_tokens(&inst, name, args, num_args, line);
+    append_inst(out, &inst);
     return 1;
+}
+
+/* Appends instruction OP of the expansion of a pseudoinstruction to OUT.
+   A, B and C are its operands; only as many as OP takes are used.
+ */
+static void emit(InstList* out, uint32_t line, int op, Operand a, Operand b,
+    Operand c) {
+    Inst inst;
+    inst.op = op;
+    inst.name = INST_TABLE[op].name;
+    inst.name_len = INST_TABLE[op].len;
+    inst.line = line;
+    inst.num_args = INST_TABLE[op].num_args;
+    inst.args[0] = a;
+    inst.args[1] = b;
+    inst.args[2] = c;
+    append_inst(out, &inst);
+}
 
+static Operand reg_operand(int reg) {
+    Operand operand = {OPND_REG, 0, reg, NULL};
+    return operand;
+}
+
+static Operand imm_operand(long int value) {
+    Operand operand = {OPND_IMM, 0, value, NULL};
+    return operand;
+}
+
+/* Returns the operand SOURCE of a pseudoinstruction step. */
+static Operand step_operand(uint8_t source, const Token* args) {
+    Operand operand;
+    switch (source) {
+        case STEP_AT:
+            return reg_operand(1);
+        case STEP_ZERO:
+            return reg_operand(0);
+        default:
+            translate_operand_n(&operand, args[source].ptr, args[source].len);
+            return operand;
+    }
+}
+
+/* Expands a pseudoinstruction by emitting each step of DESC in order. */
+static unsigned expand_steps(InstList* out, uint32_t line, const InstDesc* desc,
+    const Token* args) {
+    for (int i = 0; i < desc->num_steps; i++) {
+        const PseudoStep* step = &desc->steps[i];
+        Operand ops[INST_MAX_ARGS];
+        for (int j = 0; j < INST_TABLE[step->op].num_args; j++) {
+            ops[j] = step_operand(step->args[j], args);
+        }
+        emit(out, line, step->op, ops[0], ops[1], ops[2]);
+    }
+    return desc->num_steps;
+}
+
+/* Expands li into addiu if the immediate fits in 16 signed bits, and into a
+   lui-ori pair through $at otherwise. */
+static unsigned expand_li(InstList* out, uint32_t line, const InstDesc* desc,
+    const Token* args) {
+    long int new_imm;
+    long int lowest_signed_number = -2147483648;
+    long int highest_unsigned_number = 4294967295;
+    int success = translate_num_n(&new_imm, args[1].ptr, args[1].len,
+        lowest_signed_number, highest_unsigned_number);
+    if (success != 0) {
+        return 0;
+    }
+    Operand none = imm_operand(0);
+    long int lowest_signed_16bit_number = -32768;
+    long int highest_signed_16bit_number = 32767;
+    if (new_imm >= lowest_signed_16bit_number && new_imm <= highest_signed_16bit_number) {
+        emit(out, line, INST_ADDIU, step_operand(STEP_ARG0, args),
+            reg_operand(0), imm_operand(new_imm));
+        return 1;
+    }
+    long int highest_unsigned_16bit_number = 65535;
+    long int upper_bits = (new_imm >> 16) & highest_unsigned_16bit_number;
+    long int lower_bits = (new_imm & highest_unsigned_16bit_number);
+    emit(out, line, INST_LUI, reg_operand(1), imm_operand(upper_bits), none);
+    emit(out, line, INST_ORI, step_operand(STEP_ARG0, args), reg_operand(1),
+        imm_operand(lower_bits));
+    return 2;
+}
+
+/* Decodes the instruction NAME with arguments ARGS into INST. LINE is stored
+   as the instruction's input line. The operands of INST point into ARGS, and
+   for unknown instructions INST->name points to NAME.
+ */
+void decode_inst(Inst* inst, const char* name, char** args, int num_args,
+    uint32_t line) {
+    Token tokens[INST_MAX_ARGS];
+    to_tokens(tokens, args, num_args);
+    Token name_token = {name, strlen(name)};
+    decode_tokens(inst, name_token, tokens, num_args, line);
+}
+
+/* Same as decode_inst(), for token views of the source. The operands and (for
+   unknown instructions) the name of INST point into the tokens and are not
+   NUL-terminated; append_inst() makes terminated copies.
+ */
+void decode_tokens(Inst* inst, Token name, const Token* args, int num_args,
+    uint32_t line) {
+    const InstDesc* desc = find_inst(name.ptr, name.len);
+    if (desc && desc->format != FMT_PSEUDO) {
+        inst->op = desc - INST_TABLE;
+        inst->name = desc->name;
+        inst->name_len = desc->len;
+    } else {
+        inst->op = INST_UNKNOWN;
+        inst->name = name.ptr;
+        inst->name_len = name.len;
+    }
+    inst->line = line;
+    inst->num_args = num_args;
+    for (int i = 0; i < num_args; i++) {
+        translate_operand_n(&inst->args[i], args[i].ptr, args[i].len);
+    }
 }
 
 /* Writes the instruction in hexadecimal format to OUTPUT during pass #2.
@@ -145,256 +346,175 @@ unsigned write_pass_one(FILE* output, const char* name, char** args, int num_arg
    anything to OUTPUT but simply return -1. MARS may be a useful resource for
    this step.
 
-   Some function declarations for the write_*() functions are provided in translate.h, and you MUST implement these
-   and use these as function headers. You may use helper functions, but you still must implement
-   the provided write_* functions declared in translate.h.
-
    Returns 0 on success and -1 on error. 
  */
 int translate_inst(FILE* output, const char* name, char** args, size_t num_args, uint32_t addr,
     SymbolTable* symtbl, SymbolTable* reltbl) {
-    if (strcmp(name, "addu") == 0)       return write_rtype (0x21, output, args, num_args);
-    else if (strcmp(name, "or") == 0)    return write_rtype (0x25, output, args, num_args);
-    else if (strcmp(name, "slt") == 0)   return write_rtype (0x2a, output, args, num_args);
-    else if (strcmp(name, "sltu") == 0)  return write_rtype (0x2b, output, args, num_args);
-    else if (strcmp(name, "sll") == 0)   return write_shift (0x00, output, args, num_args);
-    else if (strcmp(name, "jr") == 0)     return write_jr (0x08, output, args, num_args);
-    else if (strcmp(name, "addiu") == 0)  return write_addiu (0x9, output, args, num_args);
-    else if (strcmp(name, "ori") == 0)    return write_ori (0xd, output, args, num_args);
-    else if (strcmp(name, "lui") == 0)    return write_lui (0xf, output, args, num_args);
-    else if (strcmp(name, "lb") == 0)    return write_mem (0x20, output, args, num_args);
-    else if (strcmp(name, "lw") == 0)    return write_mem (0x23, output, args, num_args);
-    else if (strcmp(name, "lbu") == 0)   return write_mem (0x24, output, args, num_args);
-    else if (strcmp(name, "sb") == 0)    return write_mem (0x28, output, args, num_args);
-    else if (strcmp(name, "sw") == 0)    return write_mem (0x2b, output, args, num_args);
-    else if (strcmp(name, "beq") == 0)    return write_branch (0x4, output, args, num_args, addr, symtbl);
-    else if (strcmp(name, "bne") == 0)    return write_branch (0x5, output, args, num_args, addr, symtbl);
-    else if (strcmp(name, "j") == 0)    return write_jump (0x2, output, args, num_args, addr, reltbl);
-    else if (strcmp(name, "jal") == 0)  return write_jump (0x03, output, args, num_args, addr, reltbl);
-    else                                 return -1;
-}
-
-/* A helper function for writing most R-type instructions. You should use
-   translate_reg() to parse registers and write_inst_hex() to write to 
-   OUTPUT. Both are defined in translate_utils.h.
-
-   This function is INCOMPLETE. Complete the implementation below. You will
-   find bitwise operations to be the cleanest way to complete this function.
- */
-int write_rtype(uint8_t funct, FILE* output, char** args, size_t num_args) {
-    // Perhaps perform some error checking?
-    if (num_args != 3) {
-      return -1;
-    }
-    int rd = translate_reg(args[0]);
-    int rs = translate_reg(args[1]);
-    int rt = translate_reg(args[2]);
-    if ((rs == -1 )|| (rd == -1) || (rt == -1)) {
-      return -1;
+    if (num_args > INST_MAX_ARGS) {
+        return -1;
     }
+    Inst inst;
     uint32_t instruction;
-    instruction = (0 << 26);
-    instruction += (rs << 21);
-    instruction += (rt << 16);
-    instruction += (rd << 11);
-    instruction += (0 << 6);
-    instruction += funct;
-    write_inst_hex(output, instruction);
-    return 0;
-}
-
-/* A helper function for writing shift instructions. You should use 
-   translate_num() to parse numerical arguments. translate_num() is defined
-   in translate_utils.h.
-
-   This function is INCOMPLETE. Complete the implementation below. You will
-   find bitwise operations to be the cleanest way to complete this function.
- */
-int write_shift(uint8_t funct, FILE* output, char** args, size_t num_args) {
-	// Perhaps perform some error checking?
-    if (num_args != 3) {
-      return -1;
+    decode_inst(&inst, name, args, num_args, 0);
+    if (encode_inst(&instruction, &inst, addr, symtbl, reltbl) == -1) {
+        return -1;
     }
-    long int s;
-    int rd = translate_reg(args[0]);
-    int rt = translate_reg(args[1]);
-    int err = translate_num(&s, args[2], 0, 31);
-    if ((rd == -1) || (rt == -1) || err == -1) {
-      return -1;
-    }
-    uint32_t instruction;
-    instruction = (0 << 26);
-    instruction += (0 << 21);
-    instruction += (rt << 16);
-    instruction += (rd << 11);
-    instruction += (s << 6);
-    instruction += funct;
     write_inst_hex(output, instruction);
     return 0;
 }
 
-/* The rest of your write_*() functions below */
+/* Encodes the decoded instruction INST, located at byte offset ADDR, into
+   OUTPUT using the write_*() function for its format. Symbols are resolved and
+   relocated as described for translate_inst().
 
-int write_jr(uint8_t funct, FILE* output, char** args, size_t num_args) {
-    // Perhaps perform some error checking?
-    if (num_args != 1) {
-      return -1;
-    }
-    int rs = translate_reg(args[0]);
-    if (rs == -1) {
-      return -1;
+   Returns 0 on success and -1 on error, in which case OUTPUT is not modified.
+ */
+int encode_inst(uint32_t* output, const Inst* inst, uint32_t addr,
+    SymbolTable* symtbl, SymbolTable* reltbl) {
+    const InstDesc* desc = &INST_TABLE[inst->op];
+    switch (desc->format) {
+        case FMT_R:      return write_rtype(desc, output, inst->args, inst->num_args);
+        case FMT_I:      return write_itype(desc, output, inst->args, inst->num_args);
+        case FMT_BRANCH: return write_branch(desc, output, inst->args, inst->num_args, addr, symtbl);
+        case FMT_JUMP:   return write_jump(desc, output, inst->args, inst->num_args, addr, reltbl);
+        default:         return -1;
     }
-    uint32_t instruction;
-    instruction = (0 << 26);
-    instruction += (rs << 21);
-    instruction += (0 << 16);
-    instruction += (0 << 11); 
-    instruction += (0 << 6);
-    instruction += funct;
-    write_inst_hex(output, instruction);
-    return 0;
 }
 
-int write_addiu(uint8_t opcode, FILE* output, char** args, size_t num_args) {
-    // Perhaps perform some error checking?
-    if (num_args != 3) {
-      return -1;
+/* Adds operand ARG to INSTRUCTION in the register, shift amount or immediate
+   field FIELD. Returns -1 if ARG is the wrong kind of operand for the field or
+   out of range, and 0 otherwise.
+ */
+static int write_field(uint32_t* instruction, uint8_t field, const Operand* arg) {
+    if (field <= FIELD_RD) {
+        if (arg->kind != OPND_REG) {
+            return -1;
+        }
+        int shift = field == FIELD_RS ? 21 : field == FIELD_RT ? 16 : 11;
+        *instruction |= (uint32_t) arg->value << shift;
+        return 0;
     }
-    uint32_t instruction;
-    int rs = translate_reg(args[0]);
-    int rt = translate_reg(args[1]);
-    if ((rs == -1 )|| (rt == -1)) {
-      return -1;
+    if (arg->kind != OPND_IMM) {
+        return -1;
     }
-    long int i;
-    int num = translate_num(&i, args[2], INT_MIN, INT_MAX);
-    if (num == -1) {
-      return -1;
+    long int i = arg->value;
+    switch (field) {
+        case FIELD_SHAMT:
+            if (i < 0 || i > 31) {
+                return -1;
+            }
+            *instruction |= (uint32_t) i << 6;
+            return 0;
+        case FIELD_SIMM:
+            if (i < -32768 || i > 32767) {
+                return -1;
+            }
+            *instruction |= (uint32_t) i & 0xffff;
+            return 0;
+        case FIELD_UIMM:
+            if (i < 0 || i > 65535) {
+                return -1;
+            }
+            *instruction |= (uint32_t) i;
+            return 0;
+        default:
+            return -1;
     }
-    instruction = (opcode << 26);
-    instruction += (rt << 21);
-    instruction += (rs << 16);
-    instruction += i;
-    write_inst_hex(output, instruction);
-    return 0;
 }
 
-int write_ori(uint8_t opcode, FILE* output, char** args, size_t num_args) {
-    // Perhaps perform some error checking?
-    if (num_args != 3) {
+/* Encodes every operand of DESC except labels into INSTRUCTION. */
+static int write_fields(const InstDesc* desc, uint32_t* instruction,
+    const Operand* args, size_t num_args) {
+    if (num_args != desc->num_args) {
       return -1;
     }
-    uint32_t instruction;
-    int rt = translate_reg(args[0]);
-    int rs = translate_reg(args[1]);
-    if ((rs == -1 )|| (rt == -1)) {
-      return -1;
-    }
-    long int i;
-    int num = translate_num(&i, args[2], 0, UINT_MAX);
-    if (num == -1) {
-      return -1;
+    for (size_t i = 0; i < num_args; i++) {
+        if (desc->fields[i] != FIELD_LABEL
+            && write_field(instruction, desc->fields[i], &args[i]) == -1) {
+            return -1;
+        }
     }
-    instruction = (opcode << 26);
-    instruction += (rs << 21);
-    instruction += (rt << 16);
-    instruction += i;
-    write_inst_hex(output, instruction);
     return 0;
-} 
+}
 
-int write_lui(uint8_t opcode, FILE* output, char** args, size_t num_args) {
-    // Perhaps perform some error checking?
-    if (num_args != 2) {
-      return -1;
-    }
-    int rt = translate_reg(args[0]);
-    if (rt == -1) {
-      return -1;
-    }
-    long int i;
-    int num = translate_num(&i, args[1], LONG_MIN, LONG_MAX);
-    if (num == -1) {
+/* A helper function for writing R-type instructions. The register and shift
+   amount operands go into the fields listed in DESC, and DESC->funct into the
+   funct field.
+ */
+int write_rtype(const InstDesc* desc, uint32_t* output, const Operand* args, size_t num_args) {
+    uint32_t instruction = desc->funct;
+    if (write_fields(desc, &instruction, args, num_args) == -1) {
       return -1;
     }
-    uint32_t instruction;
-    instruction = (opcode << 26);
-    instruction += (0 << 21);
-    instruction += (rt << 16);
-    instruction += i;
-    write_inst_hex(output, instruction);
+    *output = instruction;
     return 0;
 }
 
-int write_mem(uint8_t opcode, FILE* output, char** args, size_t num_args) {
-    // Perhaps perform some error checking?
-    if (num_args != 3) {
-      return -1;
-    }
-    uint32_t instruction; 
-    int rs = translate_reg(args[0]);
-    int rt = translate_reg(args[2]);
-    if (rt == -1 || rs == -1) {
-      return -1;
-    }
-    long int i;
-    int num = translate_num(&i, args[1], INT_MIN, INT_MAX);
-    if (num == -1) {
+/* A helper function for writing I-type instructions other than branches.
+   Immediates must fit in 16 bits, signed or unsigned as listed in DESC.
+ */
+int write_itype(const InstDesc* desc, uint32_t* output, const Operand* args, size_t num_args) {
+    uint32_t instruction = (uint32_t) desc->opcode << 26;
+    if (write_fields(desc, &instruction, args, num_args) == -1) {
       return -1;
     }
-    instruction = (opcode << 26);
-    instruction += (rt << 21);
-    instruction += (rs << 16);
-    instruction += i;
-    write_inst_hex(output, instruction);
+    *output = instruction;
     return 0;
 }
+
 /*  A helper function to determine if a destination address
     can be branched to
 */
-static int can_branch_to(uint32_t src_addr, uint32_t dest_addr) {
+int can_branch_to(uint32_t src_addr, uint32_t dest_addr) {
     int32_t diff = dest_addr - src_addr;
     return (diff >= 0 && diff <= TWO_POW_SEVENTEEN) || (diff < 0 && diff >= -(TWO_POW_SEVENTEEN - 4));
 }
 
-
-int write_branch(uint8_t opcode, FILE* output, char** args, size_t num_args, uint32_t addr, SymbolTable* symtbl) {
-    // Perhaps perform some error checking?
-    if (num_args != 3) {
-      return -1;
-    }
-    int rs = translate_reg(args[0]);
-    int rt = translate_reg(args[1]);
-    if ((rt == -1) || (rs == -1)) {
+/* Fills in the offset of the branch INSTRUCTION at ADDR, which must still
+   be 0, so that it branches to LABEL_ADDR. Returns -1 if LABEL_ADDR is out of
+   reach and 0 otherwise.
+ */
+int patch_branch(uint32_t* instruction, uint32_t addr, uint32_t label_addr) {
+    int ok = can_branch_to(addr, label_addr);
+    if (ok == 0) {
       return -1;
     }
-    int label_addr = get_addr_for_symbol(symtbl, args[2]);
-    if (label_addr == -1) {
+    int32_t offset = ((int32_t) label_addr - (int32_t) (addr + 4)) / 4;
+    *instruction |= (uint32_t) offset & 0xffff;
+    return 0;
+}
+
+/* Encodes a branch to the label looked up in SYMTBL. If SYMTBL is NULL the
+   offset is left 0, for the caller to fill in with patch_branch() once the
+   label is known. A branch made by relax_branches() has its offset instead
+   of a label.
+ */
+int write_branch(const InstDesc* desc, uint32_t* output, const Operand* args, size_t num_args,
+    uint32_t addr, SymbolTable* symtbl) {
+    uint32_t instruction = (uint32_t) desc->opcode << 26;
+    if (write_fields(desc, &instruction, args, num_args) == -1) {
       return -1;
     }
-    int ok = can_branch_to(addr, label_addr);
-    if (ok == 0) {
+    if (args[2].kind == OPND_OFFSET) {
+      instruction |= (uint32_t) args[2].value & 0xffff;
+    } else if (args[2].kind != OPND_LABEL) {
       return -1;
+    } else if (symtbl) {
+      int64_t label_addr = get_addr_for_symbol_n(symtbl, args[2].text, args[2].len);
+      if (label_addr == -1 || patch_branch(&instruction, addr, label_addr) == -1) {
+        return -1;
+      }
     }
-    int32_t offset = 0;
-    offset = (label_addr - (addr + 4)) / 4;
-    uint32_t instruction;
-    instruction = (opcode << 26);
-    instruction += (rs << 21);
-    instruction += (rt << 16);
-    instruction += offset;
-    write_inst_hex(output, instruction);        
+    *output = instruction;
     return 0;
 }
 
-int write_jump(uint8_t opcode, FILE* output, char** args, size_t num_args, uint32_t addr, SymbolTable* reltbl) {
-    if (num_args != 1) {
+int write_jump(const InstDesc* desc, uint32_t* output, const Operand* args, size_t num_args,
+    uint32_t addr, SymbolTable* reltbl) {
+    if (num_args != desc->num_args || args[0].kind != OPND_LABEL) {
       return -1;
     }
-    uint32_t instruction;
-    add_to_table(reltbl, args[0], addr);
-    instruction = (opcode << 26);
-    // instruction += addr;
-    write_inst_hex(output, instruction);
-  return 0;
+    add_to_table_n(reltbl, args[0].text, args[0].len, addr);
+    *output = (uint32_t) desc->opcode << 26;
+    return 0;
 }
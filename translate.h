@@ -3,35 +3,119 @@
 
 #include <stdint.h>
 
+#include "ir.h"
+
+/* Instruction formats. Pseudoinstructions have no encoding of their own. */
+typedef enum {
+    FMT_PSEUDO,
+    FMT_R,          // opcode 0, funct and register/shamt fields
+    FMT_I,          // opcode, registers and a 16-bit immediate
+    FMT_BRANCH,     // opcode, two registers and a PC-relative label
+    FMT_JUMP        // opcode and a relocated label
+} InstFormat;
+
+/* Where an operand is encoded in the instruction word. */
+typedef enum {
+    FIELD_RS,
+    FIELD_RT,
+    FIELD_RD,
+    FIELD_SHAMT,
+    FIELD_SIMM,     // signed 16-bit immediate
+    FIELD_UIMM,     // unsigned 16-bit immediate
+    FIELD_LABEL     // branch or jump target
+} InstField;
+
+/* Sources for the operands of an instruction in a pseudoinstruction
+   expansion: one of the pseudoinstruction's own arguments or a fixed register.
+ */
+typedef enum {
+    STEP_ARG0,
+    STEP_ARG1,
+    STEP_ARG2,
+    STEP_AT,
+    STEP_ZERO
+} StepSource;
+
+typedef struct {
+    uint8_t op;                         // InstOp of the expanded instruction
+    uint8_t args[INST_MAX_ARGS];        // StepSource of each of its operands
+} PseudoStep;
+
+typedef struct InstDesc InstDesc;
+
+/* Expands the pseudoinstruction DESC with arguments ARGS into OUT. */
+typedef unsigned (*PseudoExpander)(InstList* out, uint32_t line,
+    const InstDesc* desc, const Token* args);
+
+/* Describes one mnemonic. An entry may have both a real encoding and a
+   pseudoinstruction form (like div), in which case the pseudoinstruction is
+   used when it is given PSEUDO_ARGS arguments.
+ */
+struct InstDesc {
+    const char* name;
+    uint8_t len;                        // strlen(name)
+    uint8_t format;                     // InstFormat of the real instruction
+    uint8_t opcode;
+    uint8_t funct;
+    uint8_t num_args;                   // operands of the real instruction
+    uint8_t fields[INST_MAX_ARGS];      // InstField of each operand
+    uint8_t pseudo_args;                // operands of the pseudo form, or 0
+    uint8_t num_steps;
+    const PseudoStep* steps;
+    PseudoExpander expand;
+};
+
+/* Returns the descriptor of the mnemonic NAME of length LEN, or NULL. */
+const InstDesc* find_inst(const char* name, size_t len);
+
+/* Returns the descriptor of the instruction OP. */
+const InstDesc* inst_desc(int op);
+
 /* IMPLEMENT ME - see documentation in translate.c */
 unsigned write_pass_one(FILE* output, const char* name, char** args, int num_args);
 
+/* See documentation in translate.c */
+unsigned expand_pass_one(InstList* out, uint32_t line, const char* name,
+    char** args, int num_args);
+
+/* See documentation in translate.c */
+unsigned expand_tokens(InstList* out, uint32_t line, Token name,
+    const Token* args, int num_args);
+
 /* IMPLEMENT ME - see documentation in translate.c */
-int translate_inst(FILE* output, const char* name, char** args, size_t num_args, 
+int translate_inst(FILE* output, const char* name, char** args, size_t num_args,
     uint32_t addr, SymbolTable* symtbl, SymbolTable* reltbl);
 
-/* Declaring helper functions: */
-
-int write_rtype(uint8_t funct, FILE* output, char** args, size_t num_args);
+/* See documentation in translate.c */
+void decode_inst(Inst* inst, const char* name, char** args, int num_args,
+    uint32_t line);
 
-int write_shift(uint8_t funct, FILE* output, char** args, size_t num_args);
+/* See documentation in translate.c */
+void decode_tokens(Inst* inst, Token name, const Token* args, int num_args,
+    uint32_t line);
 
-/* IMPLEMENT ME ~ write*_ functions*/
+int encode_inst(uint32_t* output, const Inst* inst, uint32_t addr,
+    SymbolTable* symtbl, SymbolTable* reltbl);
 
-int write_jr(uint8_t funct, FILE* output, char** args, size_t num_args);
+/* Declaring helper functions. Each encodes one instruction format, using DESC
+   for the opcode, funct and operand fields. */
 
-int write_addiu(uint8_t opcode, FILE* output, char** args, size_t num_args);
+int write_rtype(const InstDesc* desc, uint32_t* output, const Operand* args,
+    size_t num_args);
 
-int write_ori(uint8_t opcode, FILE* output, char** args, size_t num_args);
+int write_itype(const InstDesc* desc, uint32_t* output, const Operand* args,
+    size_t num_args);
 
-int write_lui(uint8_t opcode, FILE* output, char** args, size_t num_args);
+int write_branch(const InstDesc* desc, uint32_t* output, const Operand* args,
+    size_t num_args, uint32_t addr, SymbolTable* symtbl);
 
-int write_mem(uint8_t opcode, FILE* output, char** args, size_t num_args);
+int write_jump(const InstDesc* desc, uint32_t* output, const Operand* args,
+    size_t num_args, uint32_t addr, SymbolTable* reltbl);
 
-int write_branch(uint8_t opcode, FILE* output, char** args, size_t num_args, 
-    uint32_t addr, SymbolTable* symtbl);
+/* Returns 1 if a branch at SRC_ADDR can reach DEST_ADDR, and 0 otherwise. */
+int can_branch_to(uint32_t src_addr, uint32_t dest_addr);
 
-int write_jump(uint8_t opcode, FILE* output, char** args, size_t num_args, 
-    uint32_t addr, SymbolTable* reltbl);
+/* See documentation in translate.c */
+int patch_branch(uint32_t* instruction, uint32_t addr, uint32_t label_addr);
 
 #endif
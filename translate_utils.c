@@ -2,9 +2,17 @@
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
+#include <limits.h>
 
 #include "translate_utils.h"
 
+static const char* REG_NAMES[32] = {
+    "$zero", "$at", "$v0", "$v1", "$a0", "$a1", "$a2", "$a3",
+    "$t0", "$t1", "$t2", "$t3", "$t4", "$t5", "$t6", "$t7",
+    "$s0", "$s1", "$s2", "$s3", "$s4", "$s5", "$s6", "$s7",
+    "$t8", "$t9", "$k0", "$k1", "$gp", "$sp", "$fp", "$ra"
+};
+
 void write_inst_string(FILE* output, const char* name, char** args, int num_args) {
     fprintf(output, "%s", name);
     for (int i = 0; i < num_args; i++) {
@@ -13,6 +21,51 @@ void write_inst_string(FILE* output, const char* name, char** args, int num_args
     fprintf(output, "\n");
 }
 
+void write_inst(FILE* output, const Inst* inst) {
+    char buf[64];
+    fprintf(output, "%s", inst->name);
+    for (int i = 0; i < inst->num_args; i++) {
+        format_operand(buf, sizeof(buf), &inst->args[i]);
+        fprintf(output, " %s", buf);
+    }
+    fprintf(output, "\n");
+}
+
+void write_inst_text(Writer* writer, const Inst* inst) {
+    write_bytes(writer, inst->name, inst->name_len);
+    for (int i = 0; i < inst->num_args; i++) {
+        const Operand* operand = &inst->args[i];
+        write_char(writer, ' ');
+        switch (operand->kind) {
+            case OPND_REG:
+                write_string(writer, reg_name(operand->value));
+                break;
+            case OPND_IMM:
+                write_long(writer, operand->value);
+                break;
+            default:
+                write_bytes(writer, operand->text, operand->len);
+                break;
+        }
+    }
+    write_char(writer, '\n');
+}
+
+void format_operand(char* buf, size_t size, const Operand* operand) {
+    switch (operand->kind) {
+        case OPND_REG:
+            snprintf(buf, size, "%s", reg_name(operand->value));
+            break;
+        case OPND_IMM:
+        case OPND_OFFSET:
+            snprintf(buf, size, "%ld", operand->value);
+            break;
+        default:
+            snprintf(buf, size, "%.*s", (int) operand->len, operand->text);
+            break;
+    }
+}
+
 void write_inst_hex(FILE *output, uint32_t instruction) {
     fprintf(output, "%08x\n", instruction);
 }
@@ -21,21 +74,23 @@ int is_valid_label(const char* str) {
     if (!str) {
         return 0;
     }
+    return is_valid_label_n(str, strlen(str));
+}
 
-    int first = 1;
-    while (*str) {
-        if (first) {
-            if (!isalpha((int) *str) && *str != '_') {
-                return 0;   // does not start with letter or underscore
-            } else {
-                first = 0;
-            }
-        } else if (!isalnum((int) *str) && *str != '_') {
+/* Same as is_valid_label(), for the LEN characters at STR. */
+int is_valid_label_n(const char* str, size_t len) {
+    if (len == 0) {
+        return 0;           // empty string is invalid
+    }
+    if (!isalpha((unsigned char) str[0]) && str[0] != '_') {
+        return 0;           // does not start with letter or underscore
+    }
+    for (size_t i = 1; i < len; i++) {
+        if (!isalnum((unsigned char) str[i]) && str[i] != '_') {
             return 0;       // subsequent characters not alphanumeric
         }
-        str++;
     }
-    return first ? 0 : 1;   // empty string is invalid
+    return 1;
 }
 
 /* Translate the input string into a signed number. The number is then 
@@ -70,30 +125,147 @@ int translate_num(long int* output, const char* str, long int lower_bound,
     return -1;
 }
 
+/* Same as translate_num(), for the LEN characters at STR (which need not be
+   NUL-terminated). Accepts what strtol() accepts with base 0 - an optional
+   sign, then a decimal, 0x-prefixed hexadecimal or 0-prefixed octal number -
+   except for leading whitespace, and rejects numbers that overflow a long.
+ */
+int translate_num_n(long int* output, const char* str, size_t len,
+    long int lower_bound, long int upper_bound) {
+    if (!str || !output) {
+        return -1;
+    }
+    const char* end = str + len;
+    int negative = 0;
+    if (str < end && (*str == '-' || *str == '+')) {
+        negative = *str == '-';
+        str++;
+    }
+
+    unsigned base = 10;
+    if (end - str > 2 && str[0] == '0' && (str[1] == 'x' || str[1] == 'X')) {
+        base = 16;
+        str += 2;
+    } else if (end - str > 1 && str[0] == '0') {
+        base = 8;
+        str++;
+    }
+    if (str == end) {
+        return -1;
+    }
+
+    unsigned long limit = negative ? (unsigned long) LONG_MAX + 1 : LONG_MAX;
+    unsigned long value = 0;
+    for (; str < end; str++) {
+        unsigned digit;
+        if (*str >= '0' && *str <= '9') {
+            digit = *str - '0';
+        } else if ((*str | 0x20) >= 'a' && (*str | 0x20) <= 'f') {
+            digit = (*str | 0x20) - 'a' + 10;
+        } else {
+            return -1;
+        }
+        if (digit >= base || value > (limit - digit) / base) {
+            return -1;
+        }
+        value = value * base + digit;
+    }
+
+    // Negate through value - 1 so that LONG_MIN does not overflow
+    long int i = (long int) value;
+    if (negative && value > 0) {
+        i = -(long int) (value - 1) - 1;
+    }
+    if (i >= lower_bound && i <= upper_bound) {
+        *output = i;
+        return 0;
+    }
+    return -1;
+}
+
 /* Translates the register name to the corresponding register number. Please
-   see the MIPS Green Sheet for information about register numbers.
+   see the MIPS Green Sheet for information about register numbers. Both the
+   symbolic names ($zero, $at, $v0-$v1, $a0-$a3, $t0-$t9, $s0-$s7, $k0-$k1,
+   $gp, $sp, $fp, $ra) and the numeric forms $0-$31 are accepted.
 
    Returns the register number of STR or -1 if the register name is invalid.
  */
 int translate_reg(const char* str) {
-    if (strcmp(str, "$zero") == 0)      return 0;
-    else if (strcmp(str, "$0") == 0)    return 0;
-    else if (strcmp(str, "$at") == 0)   return 1;
-    else if (strcmp(str, "$v0") == 0)   return 2;
-    else if (strcmp(str, "$v1") == 0)   return 3;
-    else if (strcmp(str, "$a0") == 0)   return 4;
-    else if (strcmp(str, "$a1") == 0)   return 5;
-    else if (strcmp(str, "$a2") == 0)   return 6;
-    else if (strcmp(str, "$a3") == 0)   return 7;
-    else if (strcmp(str, "$t0") == 0)   return 8;
-    else if (strcmp(str, "$t1") == 0)   return 9;
-    else if (strcmp(str, "$t2") == 0)   return 10;
-    else if (strcmp(str, "$t3") == 0)   return 11;
-    else if (strcmp(str, "$s0") == 0)   return 16;
-    else if (strcmp(str, "$s1") == 0)   return 17;
-    else if (strcmp(str, "$s2") == 0)   return 18;
-    else if (strcmp(str, "$s3") == 0)   return 19;
-    else if (strcmp(str, "$sp") == 0)   return 29;
-    else if (strcmp(str, "$ra") == 0)   return 31;
-    else                                return -1;
+    return translate_reg_n(str, strlen(str));
+}
+
+/* Same as translate_reg(), for the LEN characters at STR (which need not be
+   NUL-terminated). Looks at no more than five characters.
+ */
+int translate_reg_n(const char* str, size_t len) {
+    if (len < 2 || len > 5 || str[0] != '$') {
+        return -1;
+    }
+    char c1 = str[1];
+    if (len == 2) {
+        return (c1 >= '0' && c1 <= '9') ? c1 - '0' : -1;
+    }
+    if (len == 5) {
+        return (c1 == 'z' && str[2] == 'e' && str[3] == 'r' && str[4] == 'o') ? 0 : -1;
+    }
+    if (len != 3) {
+        return -1;
+    }
+
+    char c2 = str[2];
+    int d = c2 - '0';
+    int digit = d >= 0 && d <= 9;
+    if (c1 >= '1' && c1 <= '3' && digit) {
+        int reg = (c1 - '0') * 10 + d;
+        return reg <= 31 ? reg : -1;
+    }
+    switch (c1) {
+        case 'a':
+            if (c2 == 't') return 1;
+            return (digit && d <= 3) ? 4 + d : -1;
+        case 'v':
+            return (digit && d <= 1) ? 2 + d : -1;
+        case 't':
+            if (!digit) return -1;
+            return d <= 7 ? 8 + d : 16 + d;
+        case 's':
+            if (c2 == 'p') return 29;
+            return (digit && d <= 7) ? 16 + d : -1;
+        case 'k':
+            return (digit && d <= 1) ? 26 + d : -1;
+        case 'g':
+            return c2 == 'p' ? 28 : -1;
+        case 'f':
+            return c2 == 'p' ? 30 : -1;
+        case 'r':
+            return c2 == 'a' ? 31 : -1;
+        default:
+            return -1;
+    }
+}
+
+const char* reg_name(int reg) {
+    return REG_NAMES[reg & 31];
+}
+
+void translate_operand(Operand* output, const char* str) {
+    translate_operand_n(output, str, strlen(str));
+}
+
+void translate_operand_n(Operand* output, const char* str, size_t len) {
+    output->value = 0;
+    output->text = NULL;
+    output->len = 0;
+    if (len > 0 && str[0] == '$') {
+        output->value = translate_reg_n(str, len);
+        output->kind = output->value == -1 ? OPND_BAD : OPND_REG;
+    } else if (translate_num_n(&output->value, str, len, LONG_MIN, LONG_MAX) == 0) {
+        output->kind = OPND_IMM;
+    } else {
+        output->kind = is_valid_label_n(str, len) ? OPND_LABEL : OPND_BAD;
+    }
+    if (output->kind == OPND_LABEL || output->kind == OPND_BAD) {
+        output->text = str;
+        output->len = len;
+    }
 }
@@ -3,12 +3,26 @@
 
 #include <stdint.h>
 
+#include "ir.h"
+#include "writer.h"
+
 /* Writes the instruction as a string to OUTPUT. NAME is the name of the 
    instruction, and its arguments are in ARGS. NUM_ARGS is the length of
    the array.
  */
 void write_inst_string(FILE* output, const char* name, char** args, int num_args);
 
+/* Writes the decoded instruction INST as a string to OUTPUT, in the same
+   format as write_inst_string().
+ */
+void write_inst(FILE* output, const Inst* inst);
+
+/* Same as write_inst(), but buffered in WRITER. */
+void write_inst_text(Writer* writer, const Inst* inst);
+
+/* Writes the text form of OPERAND into BUF, which holds SIZE bytes. */
+void format_operand(char* buf, size_t size, const Operand* operand);
+
 /* Writes the instruction to OUTPUT in hexadecimal format. */
 void write_inst_hex(FILE* output, uint32_t instruction);
 
@@ -18,11 +32,32 @@ void write_inst_hex(FILE* output, uint32_t instruction);
  */
 int is_valid_label(const char* str);
 
+/* See documentation in translate_utils.c */
+int is_valid_label_n(const char* str, size_t len);
+
 /* IMPLEMENT ME - see documentation in translate_utils.c */
 int translate_num(long int* output, const char* str, long int lower_bound, 
 	long int upper_bound);
 
+/* See documentation in translate_utils.c */
+int translate_num_n(long int* output, const char* str, size_t len,
+    long int lower_bound, long int upper_bound);
+
 /* IMPLEMENT ME - see documentation in translate_utils.c */
 int translate_reg(const char* str);
 
+/* See documentation in translate_utils.c */
+int translate_reg_n(const char* str, size_t len);
+
+/* Returns the canonical name of register REG (0-31), e.g. "$zero". */
+const char* reg_name(int reg);
+
+/* Parses STR into OUTPUT as a register, an immediate or a label, in that
+   order. OUTPUT->text points into STR, so it is only valid as long as STR is.
+ */
+void translate_operand(Operand* output, const char* str);
+
+/* Same as translate_operand(), for the LEN characters at STR. */
+void translate_operand_n(Operand* output, const char* str, size_t len);
+
 #endif
@@ -1,61 +1,309 @@
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <stdarg.h>
 #include <unistd.h>
+#include <pthread.h>
 
+#include "utils.h"
+
+#define MIN_CAPTURE_SIZE 256
+#define LOG_BUFFER_SIZE 65536
+
+/* The log sink is opened once and written through LOG_BUFFER, which is
+   flushed when it fills up, on fatal errors, by flush_log() and at exit.
+   Messages may be written in pieces (see log_inst()); each thread collects
+   its pieces in PENDING and commits them as one message at the newline, so
+   that messages of different threads never interleave.
+ */
 static const char* output_file = NULL;
+static FILE* log_file = NULL;
+static char log_buffer[LOG_BUFFER_SIZE];
+static size_t log_len = 0;
+static int flush_at_exit = 0;
+
+static int min_level = LOG_INFO;
+static uint32_t error_limit = 0;
+static uint32_t errors_logged = 0;
+static uint32_t errors_suppressed = 0;
+static uint32_t suppressed_reported = 0;
+
+static int threadsafe = 0;
+static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static __thread LogBuffer* capture = NULL;
+static __thread LogBuffer pending = {NULL, 0, 0, NULL, 0, 0};
+static __thread int pending_level = LOG_INFO;
+
+/* Appends formatted text to BUFFER. */
+static void buffer_vprintf(LogBuffer* buffer, const char* fmt, va_list args) {
+    va_list copy;
+    va_copy(copy, args);
+    int len = vsnprintf(NULL, 0, fmt, copy);
+    va_end(copy);
+    if (len < 0) {
+        return;
+    }
+    if (buffer->cap - buffer->len < (size_t) len + 1) {
+        size_t cap = buffer->cap ? buffer->cap : MIN_CAPTURE_SIZE;
+        while (cap - buffer->len < (size_t) len + 1) {
+            cap *= 2;
+        }
+        char* data = (char *) realloc(buffer->data, cap);
+        if (!data) {
+            return;
+        }
+        buffer->data = data;
+        buffer->cap = cap;
+    }
+    vsnprintf(buffer->data + buffer->len, len + 1, fmt, args);
+    buffer->len += len;
+}
+
+/* Notes that the text appended to BUFFER from now on is logged at LEVEL. */
+static void buffer_mark(LogBuffer* buffer, int level) {
+    if (buffer->num_marks > 0) {
+        LogMark* last = &buffer->marks[buffer->num_marks - 1];
+        if (last->level == level) {
+            return;
+        }
+        if (last->offset == buffer->len) {
+            last->level = level;
+            return;
+        }
+    }
+    if (buffer->num_marks == buffer->marks_cap) {
+        size_t cap = buffer->marks_cap ? 2 * buffer->marks_cap : 4;
+        LogMark* marks = (LogMark *) realloc(buffer->marks, cap * sizeof(LogMark));
+        if (!marks) {
+            return;
+        }
+        buffer->marks = marks;
+        buffer->marks_cap = cap;
+    }
+    buffer->marks[buffer->num_marks].offset = buffer->len;
+    buffer->marks[buffer->num_marks].level = level;
+    buffer->num_marks++;
+}
+
+/* Writes out LOG_BUFFER. Must hold LOG_MUTEX in thread-safe mode. */
+static void flush_sink() {
+    FILE* sink = output_file ? log_file : stderr;
+    if (log_len > 0 && sink) {
+        fwrite(log_buffer, 1, log_len, sink);
+        fflush(sink);
+    }
+    log_len = 0;
+}
+
+static void sink_write(const char* text, size_t len) {
+    if (LOG_BUFFER_SIZE - log_len < len) {
+        flush_sink();
+        if (len >= LOG_BUFFER_SIZE) {
+            FILE* sink = output_file ? log_file : stderr;
+            if (sink) {
+                fwrite(text, 1, len, sink);
+            }
+            return;
+        }
+    }
+    memcpy(log_buffer + log_len, text, len);
+    log_len += len;
+}
+
+/* Notes how many errors went over the limit since the last note. */
+static void report_suppressed() {
+    if (errors_suppressed > suppressed_reported) {
+        char note[96];
+        int len = snprintf(note, sizeof(note), "(%u more errors not shown)\n",
+            errors_suppressed - suppressed_reported);
+        sink_write(note, len);
+        suppressed_reported = errors_suppressed;
+    }
+}
+
+/* Writes one complete message to the sink, applying the level filter and the
+   error limit. */
+static void commit_message(int level, const char* text, size_t len) {
+    if (threadsafe) {
+        pthread_mutex_lock(&log_mutex);
+    }
+    if (!flush_at_exit) {
+        atexit(flush_log);
+        flush_at_exit = 1;
+    }
+    if (level < min_level) {
+        // dropped
+    } else if (level == LOG_ERROR && error_limit && errors_logged >= error_limit) {
+        errors_suppressed++;
+    } else {
+        if (level == LOG_ERROR) {
+            errors_logged++;
+        } else {
+            report_suppressed();
+        }
+        sink_write(text, len);
+    }
+    if (level == LOG_FATAL) {
+        flush_sink();
+    }
+    if (threadsafe) {
+        pthread_mutex_unlock(&log_mutex);
+    }
+}
+
+/* Commits the pending message of the calling thread. */
+static void commit_pending() {
+    if (pending.len > 0) {
+        commit_message(pending_level, pending.data, pending.len);
+        pending.len = 0;
+    }
+}
+
+static void log_vmessage(int level, const char* fmt, va_list args) {
+    if (capture) {
+        if (capture->len == 0 || capture->data[capture->len - 1] == '\n') {
+            buffer_mark(capture, level);
+        }
+        buffer_vprintf(capture, fmt, args);
+        return;
+    }
+    if (pending.len == 0) {
+        pending_level = level;
+    }
+    buffer_vprintf(&pending, fmt, args);
+    if (pending.len > 0 && pending.data[pending.len - 1] == '\n') {
+        commit_pending();
+    }
+}
 
 int is_log_file_set() {
     return output_file != NULL;
 }
 
+/* Sends the log to the file FILENAME, replacing it, or to stderr if FILENAME
+   is NULL. Anything logged before is flushed to the previous sink. */
 void set_log_file(const char* filename) {
+    flush_log();
+    if (log_file) {
+        fclose(log_file);
+        log_file = NULL;
+    }
     if (filename) {
         output_file = filename;
         unlink(filename);
+        log_file = fopen(filename, "a");
     } else {
         output_file = NULL;
     }
 }
 
+/* Logs a message of severity LEVEL. A message may be logged in several calls;
+   the level of its first part applies, and it is complete once it ends in a
+   newline.
+ */
+void log_message(int level, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    log_vmessage(level, fmt, args);
+    va_end(args);
+}
+
 void write_to_log(char* fmt, ...) {
     va_list args;
+    va_start(args, fmt);
+    log_vmessage(LOG_ERROR, fmt, args);
+    va_end(args);
+}
 
-    if (output_file) {
-        FILE* f = fopen(output_file, "a");
-        if (!f) {
-            return;
-        }
-        
-        va_start(args, fmt);
-        vfprintf(f, fmt, args);
-        va_end(args);
-        fclose(f);
-    } else {
-        va_start(args, fmt);
-        vfprintf(stderr, fmt, args);
-        va_end(args);
+void log_inst(const char* name, char** args, int num_args) {
+    log_message(LOG_ERROR, "%s", name);
+    for (int i = 0; i < num_args; i++) {
+        log_message(LOG_ERROR, " %s", args[i]);
     }
+    log_message(LOG_ERROR, "\n");
 }
 
-void log_inst(const char* name, char** args, int num_args) {
-    if (output_file) {
-        FILE* f = fopen(output_file, "a");
-        if (!f) {
-            return;
-        }
-        
-        fprintf(f, "%s", name);
-        for (int i = 0; i < num_args; i++) {
-            fprintf(f, " %s", args[i]);
-        }
-        fprintf(f, "\n");
-        fclose(f);
-    } else {
-        fprintf(stderr, "%s", name);
-        for (int i = 0; i < num_args; i++) {
-            fprintf(stderr, " %s", args[i]);
+void fatal_error(const char* fmt, ...) {
+    va_list args;
+    commit_pending();
+    va_start(args, fmt);
+    log_vmessage(LOG_FATAL, fmt, args);
+    va_end(args);
+    commit_pending();
+    exit(1);
+}
+
+void set_log_level(int level) {
+    min_level = level;
+}
+
+/* Logs at most LIMIT errors (0 for no limit). Errors past the limit are
+   counted, and the count is logged before the next message that is not an
+   error, or when the log is flushed. Errors logged before the call do not
+   count toward the new limit. */
+void set_error_limit(uint32_t limit) {
+    error_limit = limit;
+    errors_logged = 0;
+    errors_suppressed = 0;
+    suppressed_reported = 0;
+}
+
+/* Serializes writes to the sink so that several threads may log at once. The
+   single-threaded default avoids taking a lock for every message. */
+void set_log_threadsafe(int on) {
+    threadsafe = on;
+}
+
+/* Writes out everything logged so far, including an unfinished message of
+   the calling thread. Runs automatically at exit. */
+void flush_log() {
+    commit_pending();
+    if (threadsafe) {
+        pthread_mutex_lock(&log_mutex);
+    }
+    report_suppressed();
+    flush_sink();
+    if (threadsafe) {
+        pthread_mutex_unlock(&log_mutex);
+    }
+}
+
+/* Redirects everything the calling thread logs into BUFFER, or back to the
+   log if BUFFER is NULL. This lets threads that work on parts of the input
+   log in parallel while the log is written in input order afterwards.
+
+   Returns the buffer that was capturing before, so that captures can nest.
+ */
+LogBuffer* capture_log(LogBuffer* buffer) {
+    LogBuffer* previous = capture;
+    capture = buffer;
+    return previous;
+}
+
+/* Writes the text of BUFFER, output captured by capture_log(), from offset
+   BEGIN up to END to the log. Every message is logged at the level it was
+   captured at, so errors count toward the error limit when they are written
+   here rather than when they were captured.
+ */
+void write_log_text(const LogBuffer* buffer, size_t begin, size_t end) {
+    size_t mark = 0;
+    while (begin < end) {
+        const char* text = buffer->data + begin;
+        const char* newline = memchr(text, '\n', end - begin);
+        size_t next = newline ? (size_t) (newline + 1 - buffer->data) : end;
+        while (mark + 1 < buffer->num_marks && buffer->marks[mark + 1].offset <= begin) {
+            mark++;
         }
-        fprintf(stderr, "\n");
+        int level = buffer->num_marks > 0 ? buffer->marks[mark].level : LOG_ERROR;
+        log_message(level, "%.*s", (int) (next - begin), text);
+        begin = next;
     }
 }
+
+void free_log_buffer(LogBuffer* buffer) {
+    free(buffer->data);
+    free(buffer->marks);
+    memset(buffer, 0, sizeof(*buffer));
+}
@@ -1,8 +1,68 @@
+#ifndef UTILS_H
+#define UTILS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Severity of a log message. */
+typedef enum {
+    LOG_INFO,
+    LOG_WARNING,
+    LOG_ERROR,
+    LOG_SUMMARY,    // names what failed; not counted as an error
+    LOG_FATAL
+} LogLevel;
+
+/* The level of the captured text from OFFSET up to the next mark. */
+typedef struct {
+    size_t offset;
+    int level;
+} LogMark;
+
+/* Log output captured in memory, see capture_log(). */
+typedef struct {
+    char* data;
+    size_t len;
+    size_t cap;
+    LogMark* marks;
+    size_t num_marks;
+    size_t marks_cap;
+} LogBuffer;
 
 int is_log_file_set();
 
 void set_log_file(const char* filename);
 
+/* Logs an error. See log_message(). */
 void write_to_log(char* fmt, ...);
 
-void log_inst(const char* name, char** args, int num_args);
\ No newline at end of file
+void log_inst(const char* name, char** args, int num_args);
+
+/* See documentation in utils.c */
+void log_message(int level, const char* fmt, ...);
+
+/* Logs a fatal error, flushes the log and exits with status 1. */
+void fatal_error(const char* fmt, ...);
+
+/* Drops messages less severe than LEVEL. */
+void set_log_level(int level);
+
+/* See documentation in utils.c */
+void set_error_limit(uint32_t limit);
+
+/* See documentation in utils.c */
+void set_log_threadsafe(int threadsafe);
+
+/* See documentation in utils.c */
+void flush_log();
+
+/* See documentation in utils.c */
+LogBuffer* capture_log(LogBuffer* buffer);
+
+/* See documentation in utils.c */
+void write_log_text(const LogBuffer* buffer, size_t begin, size_t end);
+
+/* Frees the text and marks of BUFFER and empties it. */
+void free_log_buffer(LogBuffer* buffer);
+
+#endif
@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tables.h"
+#include "writer.h"
+
+#define WRITER_SIZE 65536
+#define HEX_LINE_SIZE 9         // eight digits and a newline
+
+#define HEX_ROW(hi) hi "0" hi "1" hi "2" hi "3" hi "4" hi "5" hi "6" hi "7" \
+    hi "8" hi "9" hi "a" hi "b" hi "c" hi "d" hi "e" hi "f"
+
+/* The two hex digits of every byte value, so that a word takes four lookups
+   instead of eight divisions. */
+static const char HEX_PAIRS[] =
+    HEX_ROW("0") HEX_ROW("1") HEX_ROW("2") HEX_ROW("3")
+    HEX_ROW("4") HEX_ROW("5") HEX_ROW("6") HEX_ROW("7")
+    HEX_ROW("8") HEX_ROW("9") HEX_ROW("a") HEX_ROW("b")
+    HEX_ROW("c") HEX_ROW("d") HEX_ROW("e") HEX_ROW("f");
+
+void open_writer(Writer* writer, FILE* output) {
+    writer->output = output;
+    writer->data = (char *) malloc(WRITER_SIZE);
+    if (!writer->data) {
+        allocation_failed();
+    }
+    writer->len = 0;
+    writer->cap = WRITER_SIZE;
+    writer->error = 0;
+}
+
+int flush_writer(Writer* writer) {
+    if (writer->len > 0) {
+        if (fwrite(writer->data, 1, writer->len, writer->output) != writer->len) {
+            writer->error = 1;
+        }
+        writer->len = 0;
+    }
+    return writer->error ? -1 : 0;
+}
+
+int close_writer(Writer* writer) {
+    int ret = flush_writer(writer);
+    free(writer->data);
+    writer->data = NULL;
+    return ret;
+}
+
+void write_bytes(Writer* writer, const char* text, size_t len) {
+    if (writer->cap - writer->len < len) {
+        flush_writer(writer);
+        if (len >= writer->cap) {
+            if (fwrite(text, 1, len, writer->output) != len) {
+                writer->error = 1;
+            }
+            return;
+        }
+    }
+    memcpy(writer->data + writer->len, text, len);
+    writer->len += len;
+}
+
+void write_string(Writer* writer, const char* str) {
+    write_bytes(writer, str, strlen(str));
+}
+
+void write_char(Writer* writer, char c) {
+    if (writer->len == writer->cap) {
+        flush_writer(writer);
+    }
+    writer->data[writer->len++] = c;
+}
+
+void write_long(Writer* writer, long int value) {
+    char buf[24];
+    char* p = buf + sizeof(buf);
+    unsigned long int magnitude = value < 0 ? 0UL - (unsigned long int) value : (unsigned long int) value;
+    do {
+        *--p = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while (magnitude);
+    if (value < 0) {
+        *--p = '-';
+    }
+    write_bytes(writer, p, buf + sizeof(buf) - p);
+}
+
+/* Appends each of the COUNT WORDS as eight lowercase hex digits and a newline,
+   the same text as fprintf("%08x\n") produces. Words are converted a
+   buffer at a time with a byte-pair lookup table.
+ */
+void write_hex_words(Writer* writer, const uint32_t* words, size_t count) {
+    while (count > 0) {
+        size_t room = (writer->cap - writer->len) / HEX_LINE_SIZE;
+        if (room == 0) {
+            flush_writer(writer);
+            continue;
+        }
+        size_t n = count < room ? count : room;
+        char* out = writer->data + writer->len;
+        for (size_t i = 0; i < n; i++) {
+            uint32_t word = words[i];
+            memcpy(out, HEX_PAIRS + 2 * (word >> 24), 2);
+            memcpy(out + 2, HEX_PAIRS + 2 * ((word >> 16) & 0xff), 2);
+            memcpy(out + 4, HEX_PAIRS + 2 * ((word >> 8) & 0xff), 2);
+            memcpy(out + 6, HEX_PAIRS + 2 * (word & 0xff), 2);
+            out[8] = '\n';
+            out += HEX_LINE_SIZE;
+        }
+        writer->len += n * HEX_LINE_SIZE;
+        words += n;
+        count -= n;
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Buffered text output. Text is formatted straight into a large buffer that
+   is handed to the FILE in big writes, which avoids the per-call cost of
+   fprintf() for output that is written a word or a token at a time.
+ */
+
+typedef struct {
+    FILE* output;
+    char* data;
+    size_t len;
+    size_t cap;
+    int error;              // set once a write to OUTPUT has failed
+} Writer;
+
+/* Prepares WRITER to buffer output to OUTPUT. */
+void open_writer(Writer* writer, FILE* output);
+
+/* Appends the LEN characters at TEXT. */
+void write_bytes(Writer* writer, const char* text, size_t len);
+
+/* Appends the NUL-terminated string STR. */
+void write_string(Writer* writer, const char* str);
+
+/* Appends the character C. */
+void write_char(Writer* writer, char c);
+
+/* Appends VALUE in decimal. */
+void write_long(Writer* writer, long int value);
+
+/* See documentation in writer.c */
+void write_hex_words(Writer* writer, const uint32_t* words, size_t count);
+
+/* Writes the buffered text to the output. Returns 0 on success and -1 if any
+   write has failed. */
+int flush_writer(Writer* writer);
+
+/* Flushes and frees WRITER (but does not close its FILE). Returns the same as
+   flush_writer(). */
+int close_writer(Writer* writer);
+
+#endif